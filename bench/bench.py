@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+#
+# Runs the benchmark programs in this directory a number of times and
+# reports the mean and standard deviation of the wall clock time, the
+# peak resident set size, and the objects and bytes allocated as counted
+# by 'egel --stats'. Every program is run once untimed first, such that
+# the timed runs load module caches instead of compiling. Results are
+# compared against a saved baseline, which '--save' overwrites. A run
+# with '--profile' is timed too, sampling shouldn't slow a program down
+# much.
+#
+#   bench.py [--egel <exe>] [--runs <n>] [--baseline <json>] [--save] [program..]
+
+import argparse
+import hashlib
+import json
+import os
+import statistics
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(HERE)
+
+# a profiled run may take this much longer than the mean, plus some slack
+PROFILE_OVERHEAD = 1.5
+PROFILE_SLACK    = 0.1
+
+# run once, in a directory, return wall time, peak rss in kilobytes, stdout, and stderr
+def run(egel, program, options=[], cwd=HERE):
+    cmd = [egel, '-I', os.path.join(ROOT, 'include')] + options + [program]
+    with tempfile.TemporaryFile() as out, tempfile.TemporaryFile() as err:
+        start = time.perf_counter()
+        pid = os.fork()
+        if pid == 0:
+            os.chdir(cwd)
+            os.dup2(out.fileno(), 1)
+            os.dup2(err.fileno(), 2)
+            try:
+                os.execv(egel, cmd)
+            finally:
+                os._exit(127)
+        _, status, usage = os.wait4(pid, 0)
+        wall = time.perf_counter() - start
+        out.seek(0)
+        err.seek(0)
+        stdout, stderr = out.read(), err.read()
+    if os.waitstatus_to_exitcode(status) != 0:
+        raise RuntimeError('%s failed: %s' % (program, stderr.decode()[-400:]))
+    return wall, usage.ru_maxrss, stdout, stderr
+
+def measure(egel, program, runs):
+    times = []
+    rss = 0
+    outputs = set()
+    # a first run compiles the imported modules into their caches
+    run(egel, program)
+    for _ in range(runs):
+        wall, maxrss, out, _ = run(egel, program)
+        times.append(wall)
+        rss = max(rss, maxrss)
+        outputs.add(hashlib.sha1(out).hexdigest())
+
+    counters = {}
+    _, _, _, err = run(egel, program, ['--stats'])
+    for line in err.decode().splitlines():
+        fields = line.split()
+        if len(fields) == 2 and fields[1].lstrip('-').isdigit():
+            counters[fields[0]] = int(fields[1])
+    allocated = lambda prefix: sum(v for k, v in counters.items()
+                                   if k.startswith(prefix) and k not in ('objects.live', 'objects.peak'))
+
+    # the profile is written to the working directory
+    with tempfile.TemporaryDirectory() as tmp:
+        profiled, _, _, _ = run(egel, program, ['-I', HERE, '--profile'], tmp)
+
+    return {
+        'mean':     statistics.mean(times),
+        'profiled': profiled,
+        'stddev':   statistics.stdev(times) if runs > 1 else 0.0,
+        'maxrss':   rss,
+        'objects':  allocated('objects.'),
+        'bytes':    allocated('bytes.'),
+        'output':   outputs.pop() if len(outputs) == 1 else 'nondeterministic',
+    }
+
+def change(now, then):
+    if not then:
+        return '%8s' % '-'
+    return '%+7.1f%%' % (100.0 * (now - then) / then)
+
+def main():
+    parser = argparse.ArgumentParser(description='run the egel benchmarks')
+    parser.add_argument('--egel', default=os.path.join(ROOT, 'src', 'egel'))
+    parser.add_argument('--runs', type=int, default=5)
+    parser.add_argument('--baseline', default=os.path.join(HERE, 'baseline.json'))
+    parser.add_argument('--save', action='store_true', help='save the results as the baseline')
+    parser.add_argument('programs', nargs='*')
+    args = parser.parse_args()
+
+    egel = os.path.abspath(args.egel)
+    programs = args.programs or sorted(f[:-3] for f in os.listdir(HERE) if f.endswith('.eg'))
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    print('%-12s %8s %8s %8s %9s %12s %12s %8s %8s' %
+          ('program', 'mean', 'stddev', 'change', 'maxrss', 'objects', 'bytes', 'change', 'profile'))
+    results = {}
+    differs = []
+    slow = []
+    for p in programs:
+        r = measure(egel, p + '.eg', args.runs)
+        b = baseline.get(p, {})
+        results[p] = r
+        print('%-12s %7.3fs %7.3fs %s %7dMB %12d %12d %s %7.3fs' %
+              (p, r['mean'], r['stddev'], change(r['mean'], b.get('mean')), r['maxrss'] // 1024,
+               r['objects'], r['bytes'], change(r['objects'], b.get('objects')), r['profiled']))
+        if b and b.get('output') != r['output']:
+            differs.append(p)
+        if r['profiled'] > PROFILE_OVERHEAD * r['mean'] + PROFILE_SLACK:
+            slow.append(p)
+
+    for p in differs:
+        print('%s: output differs from the baseline' % p)
+    for p in slow:
+        print('%s: profiling is too slow' % p)
+
+    if args.save:
+        with open(args.baseline, 'w') as f:
+            json.dump(results, f, indent=4, sort_keys=True)
+            f.write('\n')
+
+    return 1 if differs or slow else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -30,7 +30,7 @@ VMObjectPtr paths_to_list(VM* vm, std::vector<fs::path> ss) {
         vv.push_back(path_to_object(ss[n]));
         vv.push_back(result);
 
-        result = VMObjectArray(vv).clone();
+        result = VMObjectArray::create(vv);
     }
 
     return result;
@@ -35,7 +35,7 @@ public:
     }
 
     int compare(const VMObjectPtr& o) override {
-        auto v = (std::static_pointer_cast<ChannelValue>(o))->value();
+        auto v = (vm_object_cast<ChannelValue>(o))->value();
         if (_value < v) return -1;
         else if (v < _value) return 1;
         else return 0;
@@ -57,7 +57,7 @@ protected:
     ((o->tag() == VM_OBJECT_OPAQUE) && \
      (VM_OBJECT_OPAQUE_SYMBOL(o) == sym))
 #define CHANNEL_VALUE(o) \
-    ((std::static_pointer_cast<ChannelValue>(o))->value())
+    ((vm_object_cast<ChannelValue>(o))->value())
 
 // IO.cin
 // Standard input.
@@ -137,7 +137,7 @@ public:
         icu::UnicodeString s;
         for (auto& arg:args) {
             if (arg->tag() == VM_OBJECT_INTEGER) {
-                s += arg->to_text();
+                s += VM_OBJECT_INTEGER_CAST(arg)->to_text();
             } else if (arg->tag() == VM_OBJECT_FLOAT) {
                 s += arg->to_text();
             } else if (arg->tag() == VM_OBJECT_CHAR) {
@@ -25,7 +25,7 @@ VMObjectPtr strings_to_list(VM* vm, UnicodeStrings ss) {
         vv.push_back(VMObjectText(ss[n]).clone());
         vv.push_back(result);
 
-        result = VMObjectArray(vv).clone();
+        result = VMObjectArray::create(vv);
     }
 
     return result;
@@ -34,7 +34,7 @@ VMObjectPtr strings_to_list(VM* vm, UnicodeStrings ss) {
 
 // regex class holds a pattern
 class Regex;
-typedef std::shared_ptr<Regex>  RegexPtr;
+typedef VMObjectHandle<Regex>  RegexPtr;
 
 class Regex: public Opaque {
 public:
@@ -57,7 +57,7 @@ public:
     int compare(const VMObjectPtr& o) override {
         if ((o->tag() == VM_OBJECT_OPAQUE) &&
                 (o->symbol() == this->symbol())) {
-            RegexPtr r = std::static_pointer_cast<Regex>(o);
+            RegexPtr r = vm_object_cast<Regex>(o);
             if (string() < r->string()) {
                 return -1;
             } else if (r->string() < string()) {
@@ -107,7 +107,7 @@ public:
     }
 
     static RegexPtr regex_pattern_cast(const VMObjectPtr& o) {
-        return std::static_pointer_cast<Regex>(o);
+        return vm_object_cast<Regex>(o);
     }
 
 private:
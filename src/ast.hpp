@@ -1256,7 +1256,7 @@ public:
             os << " then ";
             then0()->render(os, indent);
             os << " else ";
-            then0()->render(os, indent);
+            else0()->render(os, indent);
         } else {
             os << "if";
             skip_line(os, indent+4);
@@ -1268,7 +1268,7 @@ public:
             skip_line(os, indent);
             os << "else";
             skip_line(os, indent+4);
-            then0()->render(os, indent+4);
+            else0()->render(os, indent+4);
         }
     }
 
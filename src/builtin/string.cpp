@@ -5,6 +5,7 @@
  * Egel's string combinators.
  *
  * Loosely follow a subset of libicu. Strings are immutable, combinators are pure.
+ * A text argument nothing else refers to is reused for the result.
  **/
 
 // String.eq s0 s1
@@ -338,13 +339,11 @@ public:
 
     VMObjectPtr apply(const VMObjectPtr& arg0, const VMObjectPtr& arg1) const override {
         if ((arg0->tag() == VM_OBJECT_TEXT) && (arg1->tag() == VM_OBJECT_TEXT)) {
-            auto s0 = VM_OBJECT_TEXT_VALUE(arg0);
             auto s1 = VM_OBJECT_TEXT_VALUE(arg1);
-            return create_text(s0.append(s1));
+            return update_text(arg0, [&](icu::UnicodeString& s0) { s0.append(s1); });
         } else if ((arg0->tag() == VM_OBJECT_TEXT) && (arg1->tag() == VM_OBJECT_CHAR)) {
-            auto s0 = VM_OBJECT_TEXT_VALUE(arg0);
             auto c  = VM_OBJECT_CHAR_VALUE(arg1);
-            return create_text(s0.append(c));
+            return update_text(arg0, [&](icu::UnicodeString& s0) { s0.append(c); });
         } else {
             return nullptr;
         }
@@ -362,8 +361,7 @@ public:
         if ((arg0->tag() == VM_OBJECT_TEXT) && (arg1->tag() == VM_OBJECT_INTEGER) && (arg2->tag() == VM_OBJECT_TEXT)) {
             auto s0 = VM_OBJECT_TEXT_VALUE(arg0);
             auto n  = VM_OBJECT_INTEGER_VALUE(arg1);
-            auto s1 = VM_OBJECT_TEXT_VALUE(arg2);
-            return create_text(s1.insert(n, s0));
+            return update_text(arg2, [&](icu::UnicodeString& s1) { s1.insert(n, s0); });
         } else {
             return nullptr;
         }
@@ -380,8 +378,7 @@ public:
         if ((arg0->tag() == VM_OBJECT_TEXT) && (arg1->tag() == VM_OBJECT_TEXT) && (arg2->tag() == VM_OBJECT_TEXT)) {
             auto s0 = VM_OBJECT_TEXT_VALUE(arg0);
             auto s1 = VM_OBJECT_TEXT_VALUE(arg1);
-            auto s2 = VM_OBJECT_TEXT_VALUE(arg2);
-            return create_text(s2.findAndReplace(s0, s1));
+            return update_text(arg2, [&](icu::UnicodeString& s2) { s2.findAndReplace(s0, s1); });
         } else {
             return nullptr;
         }
@@ -398,8 +395,7 @@ public:
         if ((arg0->tag() == VM_OBJECT_INTEGER) && (arg1->tag() == VM_OBJECT_INTEGER) && (arg2->tag() == VM_OBJECT_TEXT)) {
             auto n0 = VM_OBJECT_INTEGER_VALUE(arg0);
             auto n1 = VM_OBJECT_INTEGER_VALUE(arg1);
-            auto s0 = VM_OBJECT_TEXT_VALUE(arg2);
-            return create_text(s0.removeBetween(n0, n1));
+            return update_text(arg2, [&](icu::UnicodeString& s0) { s0.removeBetween(n0, n1); });
         } else {
             return nullptr;
         }
@@ -416,8 +412,7 @@ public:
         if ((arg0->tag() == VM_OBJECT_INTEGER) && (arg1->tag() == VM_OBJECT_INTEGER) && (arg2->tag() == VM_OBJECT_TEXT)) {
             auto n0 = VM_OBJECT_INTEGER_VALUE(arg0);
             auto n1 = VM_OBJECT_INTEGER_VALUE(arg1);
-            auto s0 = VM_OBJECT_TEXT_VALUE(arg2);
-            return create_text(s0.retainBetween(n0, n1));
+            return update_text(arg2, [&](icu::UnicodeString& s0) { s0.retainBetween(n0, n1); });
         } else {
             return nullptr;
         }
@@ -432,8 +427,7 @@ public:
 
     VMObjectPtr apply(const VMObjectPtr& arg0) const override {
         if (arg0->tag() == VM_OBJECT_TEXT) {
-            auto s = VM_OBJECT_TEXT_VALUE(arg0);
-            return create_text(s.trim());
+            return update_text(arg0, [](icu::UnicodeString& s) { s.trim(); });
         } else {
             return nullptr;
         }
@@ -448,8 +442,7 @@ public:
 
     VMObjectPtr apply(const VMObjectPtr& arg0) const override {
         if (arg0->tag() == VM_OBJECT_TEXT) {
-            auto s = VM_OBJECT_TEXT_VALUE(arg0);
-            return create_text(s.reverse());
+            return update_text(arg0, [](icu::UnicodeString& s) { s.reverse(); });
         } else {
             return nullptr;
         }
@@ -464,8 +457,7 @@ public:
 
     VMObjectPtr apply(const VMObjectPtr& arg0) const override {
         if (arg0->tag() == VM_OBJECT_TEXT) {
-            auto s = VM_OBJECT_TEXT_VALUE(arg0);
-            return create_text(s.toUpper());
+            return update_text(arg0, [](icu::UnicodeString& s) { s.toUpper(); });
         } else {
             return nullptr;
         }
@@ -480,8 +472,7 @@ public:
 
     VMObjectPtr apply(const VMObjectPtr& arg0) const override {
         if (arg0->tag() == VM_OBJECT_TEXT) {
-            auto s = VM_OBJECT_TEXT_VALUE(arg0);
-            return create_text(s.toLower());
+            return update_text(arg0, [](icu::UnicodeString& s) { s.toLower(); });
         } else {
             return nullptr;
         }
@@ -496,8 +487,7 @@ public:
 
     VMObjectPtr apply(const VMObjectPtr& arg0) const override {
         if (arg0->tag() == VM_OBJECT_TEXT) {
-            auto s = VM_OBJECT_TEXT_VALUE(arg0);
-            return create_text(s.foldCase());
+            return update_text(arg0, [](icu::UnicodeString& s) { s.foldCase(); });
         } else {
             return nullptr;
         }
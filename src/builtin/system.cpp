@@ -284,18 +284,8 @@ public:
     DYADIC_PREAMBLE(Less, "System", "<");
 
     VMObjectPtr apply(const VMObjectPtr& arg0, const VMObjectPtr& arg1) const override {
-        static VMObjectPtr _false = 0;
-        static VMObjectPtr _true = 0;
-        
-        if (_false == 0) _false = machine()->get_data_string("System", "false");
-        if (_true == 0)  _true = machine()->get_data_string("System", "true");
-
         CompareVMObjectPtr compare;
-        if (compare(arg0, arg1) < 0) {
-            return _true;
-        } else {
-            return _false;
-        }
+        return create_bool(compare(arg0, arg1) < 0);
     }
 };
 
@@ -304,18 +294,8 @@ public:
     DYADIC_PREAMBLE(LessEq, "System", "<=");
 
     VMObjectPtr apply(const VMObjectPtr& arg0, const VMObjectPtr& arg1) const override {
-        static VMObjectPtr _false = 0;
-        static VMObjectPtr _true = 0;
-        
-        if (_false == 0) _false = machine()->get_data_string("System", "false");
-        if (_true == 0)  _true = machine()->get_data_string("System", "true");
-
         CompareVMObjectPtr compare;
-        if (compare(arg0, arg1) <= 0) {
-            return _true;
-        } else {
-            return _false;
-        }
+        return create_bool(compare(arg0, arg1) <= 0);
     }
 };
 
@@ -324,18 +304,8 @@ public:
     DYADIC_PREAMBLE(Eq, "System", "==");
 
     VMObjectPtr apply(const VMObjectPtr& arg0, const VMObjectPtr& arg1) const override {
-        static VMObjectPtr _false = 0;
-        static VMObjectPtr _true = 0;
-        
-        if (_false == 0) _false = machine()->get_data_string("System", "false");
-        if (_true == 0)  _true = machine()->get_data_string("System", "true");
-
         CompareVMObjectPtr compare;
-        if (compare(arg0, arg1) == 0) {
-            return _true;
-        } else {
-            return _false;
-        }
+        return create_bool(compare(arg0, arg1) == 0);
     }
 };
 
@@ -344,18 +314,8 @@ public:
     DYADIC_PREAMBLE(NegEq, "System", "!=");
 
     VMObjectPtr apply(const VMObjectPtr& arg0, const VMObjectPtr& arg1) const override {
-        static VMObjectPtr _false = 0;
-        static VMObjectPtr _true = 0;
-        
-        if (_false == 0) _false = machine()->get_data_string("System", "false");
-        if (_true == 0)  _true = machine()->get_data_string("System", "true");
-
         CompareVMObjectPtr compare;
-        if (compare(arg0, arg1) != 0) {
-            return _true;
-        } else {
-            return _false;
-        }
+        return create_bool(compare(arg0, arg1) != 0);
     }
 };
 
@@ -370,8 +330,8 @@ public:
         if (object == 0) object = machine()->enter_symbol("System", "object");
 
         if (arg1->tag() == VM_OBJECT_ARRAY) {
-            auto ff = VM_OBJECT_ARRAY_VALUE(arg1);
-            auto sz = ff.size();
+            auto& ff = VM_OBJECT_ARRAY_REF(arg1);
+            unsigned int sz = ff.size();
             // check head is an object
             if (sz == 0) return nullptr;
             if (ff[0]->symbol() != object) return nullptr;
@@ -404,8 +364,8 @@ public:
         if (object == 0) object = machine()->enter_symbol("System", "object");
 
         if (arg2->tag() == VM_OBJECT_ARRAY) {
-            auto ff = VM_OBJECT_ARRAY_VALUE(arg2);
-            auto sz = ff.size();
+            auto& ff = VM_OBJECT_ARRAY_REF(arg2);
+            unsigned int sz = ff.size();
             // check head is an object
             if (sz == 0) return nullptr;
             if (ff[0]->symbol() != object) return nullptr;
@@ -440,10 +400,10 @@ public:
         if (object == 0) object = machine()->enter_symbol("System", "object");
 
         if ( (arg0->tag() == VM_OBJECT_ARRAY) && (arg1->tag() == VM_OBJECT_ARRAY) ) {
-            auto ff0 = VM_OBJECT_ARRAY_VALUE(arg0);
-            auto sz0 = ff0.size();
-            auto ff1 = VM_OBJECT_ARRAY_VALUE(arg1);
-            auto sz1 = ff1.size();
+            auto& ff0 = VM_OBJECT_ARRAY_REF(arg0);
+            unsigned int sz0 = ff0.size();
+            auto& ff1 = VM_OBJECT_ARRAY_REF(arg1);
+            unsigned int sz1 = ff1.size();
             // check head is an object
             if (sz0 == 0) return nullptr;
             if (ff0[0]->symbol() != object) return nullptr;
@@ -563,7 +523,7 @@ public:
         if (var == 0) var = machine()->enter_symbol("System", "v");
 
         if (arg0->tag() == VM_OBJECT_ARRAY) {
-            auto ff = VM_OBJECT_ARRAY_VALUE(arg0);
+            auto& ff = VM_OBJECT_ARRAY_REF(arg0);
             if (ff.size() != 2) return nullptr;
             if (ff[0]->symbol() != var) return nullptr;
             return ff[1];
@@ -584,7 +544,7 @@ public:
         if (var == 0) var = machine()->enter_symbol("System", "v");
 
         if (arg0->tag() == VM_OBJECT_ARRAY) {
-            auto ff = VM_OBJECT_ARRAY_VALUE(arg0);
+            auto& ff = VM_OBJECT_ARRAY_REF(arg0);
             if (ff.size() != 2) return nullptr;
             if (ff[0]->symbol() != var) return nullptr;
             auto arr = VM_OBJECT_ARRAY_CAST(arg0); // XXX: clean up this cast once. need destructive update
@@ -616,11 +576,7 @@ public:
             int len = str.length();
             for (int n = len-1; n >= 0; n--) {
                 auto c = str.char32At(n);
-                auto tt = VMObjectPtrs();
-                tt.push_back(_cons);
-                tt.push_back(VMObjectChar(c).clone());
-                tt.push_back(ss);
-                ss = VMObjectArray(tt).clone();
+                ss = VMObjectArray::create(_cons, VMObjectChar(c).clone(), ss);
             }
             return ss;
         } else {
@@ -647,7 +603,7 @@ public:
         auto a = arg0;
 
         while ( (a->tag() == VM_OBJECT_ARRAY) ) {
-            auto aa = VM_OBJECT_ARRAY_VALUE(a);
+            auto& aa = VM_OBJECT_ARRAY_REF(a);
             if (aa.size() != 3) return nullptr;
             if (aa[0]->symbol() != _cons) return nullptr;
             if (aa[1]->tag() != VM_OBJECT_CHAR) return nullptr;
@@ -686,6 +642,29 @@ public:
     }
 };
 
+// System.stats
+// A list of named counters of the runtime, kept when run with --stats
+class Stats: public Medadic {
+public:
+    MEDADIC_PREAMBLE(Stats, "System", "stats");
+
+    // not hot, looked up on every call instead of racing to initialize statics
+    VMObjectPtr apply() const override {
+        auto _nil   = machine()->get_data_string("System", "nil");
+        auto _cons  = machine()->get_data_string("System", "cons");
+        auto _tuple = machine()->get_data_string("System", "tuple");
+
+        auto ss = machine()->statistics();
+        VMObjectPtr l = _nil;
+        for (auto s = ss.rbegin(); s != ss.rend(); ++s) {
+            auto t = VMObjectArray::create(_tuple, VMObjectText(s->first).clone(), 
+                                           VMObjectInteger(s->second).clone());
+            l = VMObjectArray::create(_cons, t, l);
+        }
+        return l;
+    }
+};
+
 std::vector<VMObjectPtr> builtin_system(VM* vm) {
     std::vector<VMObjectPtr> oo;
 
@@ -735,6 +714,7 @@ std::vector<VMObjectPtr> builtin_system(VM* vm) {
     oo.push_back(Totext(vm).clone());
 
     oo.push_back(Arg(vm).clone());
+    oo.push_back(Stats(vm).clone());
 
     // move to string?
     oo.push_back(Unpack(vm).clone());
@@ -33,7 +33,7 @@ public:
     }
 
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
+        VMFrame tt(thunk);
         auto arg0   = tt[5];
 
         auto t = VM_OBJECT_ARRAY_CAST(_tuple);
@@ -61,7 +61,7 @@ public:
     }
 
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt    = VM_OBJECT_ARRAY_VALUE(thunk);
+        VMFrame tt(thunk);
         auto arg0  = tt[5];
 
         auto t = VM_OBJECT_ARRAY_CAST(_tuple);
@@ -92,24 +92,15 @@ public:
         if (sym == 0) sym = machine()->enter_symbol("System", "thread");
 
 
-        VMObjectPtrs tt;
-        tt.push_back(_tuple);
-        tt.push_back(nullptr);
-        tt.push_back(nullptr);
-        auto result = VMObjectArray(tt).clone();
-
-        VMObjectPtrs ll;
-        ll.push_back(arg0);
-        ll.push_back(_nop);
-        auto left = VMObjectArray(ll).clone();
-
-        VMObjectPtrs rr;
-        rr.push_back(arg1);
-        rr.push_back(_nop);
-        auto right = VMObjectArray(rr).clone();
+        auto result = VMObjectArray::create(_tuple, nullptr, nullptr);
+        auto left   = VMObjectArray::create(arg0, _nop);
+        auto right  = VMObjectArray::create(arg1, _nop);
 
         auto vm = machine();
 
+        // the cycle collector doesn't run with more than one thread
+        VMObjectCollector::stop();
+
         std::thread first (runthread, vm, left, 
                             VMObjectThreadResult(vm, sym, result, 1).clone(),
                             VMObjectThreadException(vm, sym, result, 1).clone() );
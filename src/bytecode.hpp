@@ -3,6 +3,10 @@
 
 #include <iostream>
 #include <iomanip>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <functional>
 #include "runtime.hpp"
 
 typedef uint16_t    reg_t;
@@ -24,12 +28,46 @@ OP_CONCATX, //  x y z i16   x := y ++ drop i z
 OP_TEST,    //  x y         flag := (x == y)
 OP_TAG,     //  x y         flag := (x, or x[0], == y)
 OP_FAIL,    //  l           pc := l, if flag
+OP_JNE,     //  x y l       pc := l, if x != y
+OP_JNT,     //  x y l       pc := l, if (x, or x[0], != y)
+OP_JNX,     //  x y z i16 l x,..,y = z[i],..,z[i+y-x], or pc := l if fail
+OP_JNS,     //  x y z l     x,..,y = z[0],..,z[y-x], or pc := l if not exact
+OP_SWITCH,  //  x k n l ..  pc := l_i if key_k(x) == c_i, else l; n pairs c_i l_i
+OP_TAIL,    //  x y z       x[5],..,x[5+z-y] := y,..,z, restart on frame x
+OP_REUSE,   //  x y z i16   x := empty array the size of y, y taken from frame z[i] if only it refers to y
+OP_JMP,     //  l           pc := l
+OP_JNA,     //  x i16 l     pc := l, if x isn't an array of i elements
+OP_ADD,     //  x y z l     x := y + z, or pc := l if not both integers or floats
+OP_SUB,     //  x y z l     x := y - z, or pc := l if not both integers or floats
+OP_MUL,     //  x y z l     x := y * z, or pc := l if not both integers or floats
+OP_DIV,     //  x y z l     x := y / z, or pc := l if not both integers or floats, or z is zero
+OP_MOD,     //  x y z l     x := y % z, or pc := l if not both integers, or z is zero
+OP_LT,      //  x y z       x := (y < z)
+OP_LE,      //  x y z       x := (y <= z)
+OP_EQ,      //  x y z       x := (y == z)
+OP_NE,      //  x y z       x := (y != z)
 OP_RETURN,  //  x           return x
 } opcode_t;
 
+static_assert(OP_RETURN < VMStatistics::OPCODES, "opcode not counted");
+
+// the primitive operations on two values, arithmetic may jump
+#define OP_IS_ARITHMETIC(op)    ((op) >= OP_ADD && (op) <= OP_MOD)
+#define OP_IS_COMPARISON(op)    ((op) >= OP_LT && (op) <= OP_NE)
+
 typedef std::vector<uint8_t>        Code;
 typedef std::map<label_t, uint32_t> Labels;
 
+// what a switch branches on
+typedef enum {
+    SWITCH_INTEGER,     // the value of an integer
+    SWITCH_CHAR,        // the value of a char
+    SWITCH_SYMBOL,      // the symbol of a combinator
+    SWITCH_TAG,         // the symbol of a value, or of its head, like tag
+} switch_kind_t;
+
+typedef std::vector<std::pair<int64_t, label_t>> SwitchCases;
+
 #define OP_SIZE         1
 #define OP_REG_SIZE     (sizeof(reg_t))
 #define OP_INT_SIZE     (sizeof(uint32_t))
@@ -52,6 +90,24 @@ typedef struct {
 #define  STRING_OP_TEST     "test"
 #define  STRING_OP_TAG      "tag"
 #define  STRING_OP_FAIL     "fail"
+#define  STRING_OP_JNE      "jne"
+#define  STRING_OP_JNT      "jnt"
+#define  STRING_OP_JNX      "jnx"
+#define  STRING_OP_JNS      "jns"
+#define  STRING_OP_SWITCH   "switch"
+#define  STRING_OP_TAIL     "tail"
+#define  STRING_OP_REUSE    "reuse"
+#define  STRING_OP_JMP      "jmp"
+#define  STRING_OP_JNA      "jna"
+#define  STRING_OP_ADD      "add"
+#define  STRING_OP_SUB      "sub"
+#define  STRING_OP_MUL      "mul"
+#define  STRING_OP_DIV      "div"
+#define  STRING_OP_MOD      "mod"
+#define  STRING_OP_LT       "lt"
+#define  STRING_OP_LE       "le"
+#define  STRING_OP_EQ       "eq"
+#define  STRING_OP_NE       "ne"
 #define  STRING_OP_RETURN   "return"
 
 class Disassembler {
@@ -61,7 +117,7 @@ public:
     }
 
 
-    const char* opcode_to_text(const opcode_t op) {
+    static const char* opcode_to_text(const opcode_t op) {
 
     static constexpr opcode_text_t opcode_text_table[] {
         { OP_NIL, STRING_OP_NIL, },
@@ -75,6 +131,24 @@ public:
         { OP_TEST, STRING_OP_TEST, },
         { OP_TAG, STRING_OP_TAG, },
         { OP_FAIL, STRING_OP_FAIL, },
+        { OP_JNE, STRING_OP_JNE, },
+        { OP_JNT, STRING_OP_JNT, },
+        { OP_JNX, STRING_OP_JNX, },
+        { OP_JNS, STRING_OP_JNS, },
+        { OP_SWITCH, STRING_OP_SWITCH, },
+        { OP_TAIL, STRING_OP_TAIL, },
+        { OP_REUSE, STRING_OP_REUSE, },
+        { OP_JMP, STRING_OP_JMP, },
+        { OP_JNA, STRING_OP_JNA, },
+        { OP_ADD, STRING_OP_ADD, },
+        { OP_SUB, STRING_OP_SUB, },
+        { OP_MUL, STRING_OP_MUL, },
+        { OP_DIV, STRING_OP_DIV, },
+        { OP_MOD, STRING_OP_MOD, },
+        { OP_LT, STRING_OP_LT, },
+        { OP_LE, STRING_OP_LE, },
+        { OP_EQ, STRING_OP_EQ, },
+        { OP_NE, STRING_OP_NE, },
         { OP_RETURN, STRING_OP_RETURN, },
     };
 
@@ -121,6 +195,11 @@ public:
         return n;
     }
 
+    int64_t fetch_i64() {
+        uint64_t n = fetch_i32();
+        return (int64_t) ((n << 32) | fetch_i32());
+    }
+
     opcode_t fetch_op() {
         return (opcode_t) fetch_i8();
     }
@@ -169,6 +248,26 @@ public:
         write_0xi32(os, (uint32_t) l);
     }
 
+    void write_kind(std::ostream& os, const switch_kind_t k) {
+        static const char* kinds[] = { "int", "char", "symbol", "tag", };
+        os << kinds[k];
+    }
+
+    void write_case(std::ostream& os, VM* vm, const switch_kind_t k, const int64_t c) {
+        switch (k) {
+        case SWITCH_INTEGER:
+            os << c;
+            break;
+        case SWITCH_CHAR:
+            VMObjectChar((UChar32) c).render(os);
+            break;
+        case SWITCH_SYMBOL:
+        case SWITCH_TAG:
+            os << vm->get_symbol((symbol_t) c);
+            break;
+        }
+    }
+
     void disassemble(std::ostream& os, VM* vm) {
 
         std::ios_base::fmtflags old_flags = os.flags();
@@ -211,6 +310,11 @@ public:
             case OP_SET:
             case OP_SPLIT:
             case OP_ARRAY:
+            case OP_TAIL:
+            case OP_LT:
+            case OP_LE:
+            case OP_EQ:
+            case OP_NE:
                 write_op(os, fetch_op());
                 write_space(os);
                 write_register(os, fetch_register());
@@ -221,6 +325,7 @@ public:
                 break;
             case OP_TAKEX:
             case OP_CONCATX:
+            case OP_REUSE:
                 write_op(os, fetch_op());
                 write_space(os);
                 write_register(os, fetch_register());
@@ -240,10 +345,79 @@ public:
                 write_register(os, fetch_register());
                 break;
             case OP_FAIL:
+            case OP_JMP:
+                write_op(os, fetch_op());
+                write_space(os);
+                write_label(os, fetch_label());
+                break;
+            case OP_JNA:
+                write_op(os, fetch_op());
+                write_space(os);
+                write_register(os, fetch_register());
+                write_space(os);
+                write_index(os, fetch_index());
+                write_space(os);
+                write_label(os, fetch_label());
+                break;
+            case OP_JNE:
+            case OP_JNT:
+                write_op(os, fetch_op());
+                write_space(os);
+                write_register(os, fetch_register());
+                write_space(os);
+                write_register(os, fetch_register());
+                write_space(os);
+                write_label(os, fetch_label());
+                break;
+            case OP_JNX:
                 write_op(os, fetch_op());
                 write_space(os);
+                write_register(os, fetch_register());
+                write_space(os);
+                write_register(os, fetch_register());
+                write_space(os);
+                write_register(os, fetch_register());
+                write_space(os);
+                write_index(os, fetch_index());
+                write_space(os);
+                write_label(os, fetch_label());
+                break;
+            case OP_JNS:
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                write_op(os, fetch_op());
+                write_space(os);
+                write_register(os, fetch_register());
+                write_space(os);
+                write_register(os, fetch_register());
+                write_space(os);
+                write_register(os, fetch_register());
+                write_space(os);
                 write_label(os, fetch_label());
                 break;
+            case OP_SWITCH:
+                write_op(os, fetch_op());
+                write_space(os);
+                write_register(os, fetch_register());
+                {
+                    auto k = (switch_kind_t) fetch_i16();
+                    auto n = fetch_i16();
+                    write_space(os);
+                    write_kind(os, k);
+                    write_space(os);
+                    write_label(os, fetch_label());
+                    for (uint16_t i = 0; i < n; i++) {
+                        auto c = fetch_i64();
+                        write_space(os);
+                        write_case(os, vm, k, c);
+                        os << ':';
+                        write_label(os, fetch_label());
+                    }
+                }
+                break;
             case OP_RETURN:
                 write_op(os, fetch_op());
                 write_space(os);
@@ -263,293 +437,2039 @@ private:
     uint32_t    _pc;
 };
 
-class Coder {
-public:
-    Coder(): 
-        _code(Code()),
-        _label_counter(0),
-        _register_counter(0),
-        _index_counter(0),
-        _labels(Labels()) {
-    }
-
-    Code code() {
-        // can only be called once
-        relabel();
-        return _code;
-    }
-
-    void reset() {
-        _code = Code();
-        _label_counter = 0;
-        _register_counter = 0;
-        _index_counter = 0;
-        _labels = Labels();
-    }
-
-    label_t generate_label() {
-        label_t l = _label_counter;
-        _label_counter++;
-        return l;
-    }
-    
-    reg_t generate_index() {
-        reg_t r = _index_counter;
-        _index_counter++;
-        return r;
-    }
-
-    reg_t generate_register() {
-        reg_t r = _register_counter;
-        _register_counter++;
-        return r;
-    }
-
-    reg_t peek_register() const {
-        return _register_counter;
-    }
+// the code of one combinator as the optimizer sees it: a list of
+// instructions and, for every label, the instruction it points at
+typedef struct {
+    opcode_t    op;
+    reg_t       x;
+    reg_t       y;
+    reg_t       z;
+    index_t     i;
+    uint32_t    n;  // data index or label
+} coder_instruction_t;
 
-    void restore_register(reg_t r) {
-        _register_counter = r;
-    }
+typedef std::vector<coder_instruction_t>    CoderInstructions;
 
-    // primitive byte emit
-    void emit_i8(uint8_t b) {
-        _code.push_back(b);
-    }
+// a switch in a program, the instruction holds its index and default
+typedef struct {
+    switch_kind_t   kind;
+    SwitchCases     cases;
+} coder_switch_t;
+
+struct Program {
+    CoderInstructions           instructions;
+    Labels                      labels;
+    std::vector<coder_switch_t> switches;
+};
 
-    void emit_i16(uint16_t n) {
-        // don't use typecasts, this is portable
-        _code.push_back( (n >> 8) & 0xFF );
-        _code.push_back( n & 0xFF );
+// the registers an instruction defines and uses, ranges are inclusive
+// and empty when the upper bound lies below the lower bound
+inline void instruction_registers(const coder_instruction_t& i, 
+                                  std::vector<reg_t>& defs, std::vector<reg_t>& uses) {
+    defs.clear();
+    uses.clear();
+    switch (i.op) {
+    case OP_NIL:
+    case OP_DATA:
+        defs.push_back(i.x);
+        break;
+    case OP_MOV:
+        defs.push_back(i.x);
+        uses.push_back(i.y);
+        break;
+    case OP_SET:
+        uses.push_back(i.x);
+        uses.push_back(i.y);
+        uses.push_back(i.z);
+        break;
+    case OP_TAKEX:
+    case OP_SPLIT:
+    case OP_JNX:
+    case OP_JNS:
+        for (int n = i.x; n <= (int) i.y; n++) defs.push_back(n);
+        uses.push_back(i.z);
+        break;
+    case OP_ARRAY:
+        defs.push_back(i.x);
+        for (int n = i.y; n <= (int) i.z; n++) uses.push_back(n);
+        break;
+    case OP_TAIL:
+        uses.push_back(i.x);
+        for (int n = i.y; n <= (int) i.z; n++) uses.push_back(n);
+        break;
+    case OP_CONCATX:
+    case OP_REUSE:
+        defs.push_back(i.x);
+        uses.push_back(i.y);
+        uses.push_back(i.z);
+        break;
+    case OP_TEST:
+    case OP_TAG:
+    case OP_JNE:
+    case OP_JNT:
+        uses.push_back(i.x);
+        uses.push_back(i.y);
+        break;
+    case OP_FAIL:
+    case OP_JMP:
+        break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_LT:
+    case OP_LE:
+    case OP_EQ:
+    case OP_NE:
+        defs.push_back(i.x);
+        uses.push_back(i.y);
+        uses.push_back(i.z);
+        break;
+    case OP_JNA:
+    case OP_SWITCH:
+    case OP_RETURN:
+        uses.push_back(i.x);
+        break;
     }
-
-    void emit_i32(uint32_t n) {
-        _code.push_back( (n >> 24) & 0xFF );
-        _code.push_back( (n >> 16) & 0xFF );
-        _code.push_back( (n >> 8) & 0xFF );
-        _code.push_back( n & 0xFF );
+}
+
+// remove the marked instructions, labels move to the next one kept
+inline void program_erase(Program& p, const std::vector<bool>& drop) {
+    auto& ii = p.instructions;
+    std::vector<uint32_t> index(ii.size() + 1, 0);
+    CoderInstructions jj;
+    for (uint32_t n = 0; n < ii.size(); n++) {
+        index[n] = jj.size();
+        if (!drop[n]) jj.push_back(ii[n]);
     }
-
-    void emit_op(const opcode_t op) {
-        emit_i8(op);
+    index[ii.size()] = jj.size();
+    for (auto& l:p.labels) {
+        l.second = index[l.second];
     }
+    ii = jj;
+}
 
-    void emit_reg(const reg_t r) {
-        emit_i16(r);
-    }
+// an edge in the control flow; 'defs' tells whether the registers the
+// source instruction defines were written along it
+typedef struct {
+    uint32_t    to;
+    bool        defs;
+} coder_edge_t;
 
-    void emit_lbl(const label_t l) {
-        emit_i32(l);
+// the control flow of a program. a takex or split directly followed by
+// a fail jumps to the fail label without having written anything
+class ControlFlow {
+public:
+    ControlFlow(const Program& p)
+        : _program(p), _targets(p.instructions.size() + 1, false) {
+        for (auto& l:p.labels) _targets[l.second] = true;
     }
 
-    void emit_idx(const index_t i) {
-        emit_i16((uint16_t) i);
+    void successors(const uint32_t n, std::vector<coder_edge_t>& ee) const {
+        auto& ii = _program.instructions;
+        auto& i  = ii[n];
+        ee.clear();
+        switch (i.op) {
+        case OP_TAIL:
+        case OP_RETURN:
+            break;
+        case OP_FAIL:
+            ee.push_back(coder_edge_t{n + 1, true});
+            if (!guarded(n)) ee.push_back(coder_edge_t{target(i.n), true});
+            break;
+        case OP_JMP:
+            ee.push_back(coder_edge_t{target(i.n), true});
+            break;
+        case OP_JNE:
+        case OP_JNT:
+        case OP_JNA:
+            ee.push_back(coder_edge_t{n + 1, true});
+            ee.push_back(coder_edge_t{target(i.n), true});
+            break;
+        case OP_JNX:
+        case OP_JNS:
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+            ee.push_back(coder_edge_t{n + 1, true});
+            ee.push_back(coder_edge_t{target(i.n), false});
+            break;
+        case OP_SWITCH:
+            ee.push_back(coder_edge_t{target(i.n), true});
+            for (auto& c:_program.switches[i.i].cases) {
+                ee.push_back(coder_edge_t{target(c.second), true});
+            }
+            break;
+        case OP_TAKEX:
+        case OP_SPLIT:
+            ee.push_back(coder_edge_t{n + 1, true});
+            if (n + 1 < ii.size() && guarded(n + 1)) {
+                ee.push_back(coder_edge_t{target(ii[n + 1].n), false});
+            }
+            break;
+        default:
+            ee.push_back(coder_edge_t{n + 1, true});
+            break;
+        }
     }
 
-    // bytecode emit
-    void emit_op_nil(const reg_t x) {
-        emit_op(OP_NIL);
-        emit_reg(x);
+    // whether a label points at instruction n
+    bool labeled(const uint32_t n) const {
+        return _targets[n];
     }
 
-    void emit_op_mov(const reg_t x, const reg_t y) {
-        emit_op(OP_MOV);
-        emit_reg(x);
-        emit_reg(y);
+    // the emitted code only jumps forward, optimizations may rely on it
+    bool forward() const {
+        std::vector<coder_edge_t> ee;
+        for (uint32_t n = 0; n < _program.instructions.size(); n++) {
+            successors(n, ee);
+            for (auto& e:ee) if (e.to <= n) return false;
+        }
+        return true;
     }
 
-    void emit_op_data(const reg_t x, const uint32_t i32) {
-        emit_op(OP_DATA);
-        emit_reg(x);
-        emit_i32(i32);
+private:
+    uint32_t target(const label_t l) const {
+        return _program.labels.at(l);
     }
 
-    void emit_op_set(const reg_t x, const reg_t y, const reg_t z) {
-        emit_op(OP_SET);
-        emit_reg(x);
-        emit_reg(y);
-        emit_reg(z);
+    // a fail which can only be reached from the takex or split before it
+    bool guarded(const uint32_t n) const {
+        auto& ii = _program.instructions;
+        return (n > 0) && (ii[n].op == OP_FAIL) && !_targets[n] &&
+               ((ii[n-1].op == OP_TAKEX) || (ii[n-1].op == OP_SPLIT));
     }
 
-    void emit_op_takex(const reg_t x, const reg_t y, const reg_t z, const index_t i) {
-        emit_op(OP_TAKEX);
-        emit_reg(x);
-        emit_reg(y);
-        emit_reg(z);
-        emit_idx(i);
-    }
+    const Program&      _program;
+    std::vector<bool>   _targets;
+};
 
-    void emit_op_split(const reg_t x, const reg_t y, const reg_t z) {
-        emit_op(OP_SPLIT);
-        emit_reg(x);
-        emit_reg(y);
-        emit_reg(z);
+// register allocation on live ranges. definitions and uses of a register
+// which reach each other form a web, and every web gets a register of
+// its own. webs which are defined or used together as a range (takex,
+// split, array) are allocated as one block. the code only jumps forward,
+// so the live range of a block is the interval between the first and 
+// last mention of its webs; backward jumps stretch the intervals they
+// cross.
+class RegisterAllocator {
+public:
+    RegisterAllocator(Program& p)
+        : _program(p) {
     }
 
-    void emit_op_array(const reg_t x, const reg_t y, const reg_t z) {
-        emit_op(OP_ARRAY);
-        emit_reg(x);
-        emit_reg(y);
-        emit_reg(z);
-    }
+    // returns the number of registers used after allocation, when
+    // 'reuse' is false every web gets a fresh register
+    reg_t allocate(const reg_t registers, const bool reuse = true) {
+        auto& ii = _program.instructions;
+        uint32_t sz = ii.size();
+        if (sz == 0) return registers;
 
-    void emit_op_concatx(const reg_t x, const reg_t y, const reg_t z, const reg_t i) {
-        emit_op(OP_CONCATX);
-        emit_reg(x);
-        emit_reg(y);
-        emit_reg(z);
-        emit_reg(i);
-    }
+        ControlFlow flow(_program);
 
-    void emit_op_test(const reg_t x, const reg_t y) {
-        emit_op(OP_TEST);
-        emit_reg(x);
-        emit_reg(y);
-    }
+        std::vector<std::vector<reg_t>> defs(sz), uses(sz);
+        for (uint32_t n = 0; n < sz; n++) {
+            instruction_registers(ii[n], defs[n], uses[n]);
+        }
 
-    void emit_op_tag(const reg_t x, const reg_t y) {
-        emit_op(OP_TAG);
-        emit_reg(x);
-        emit_reg(y);
-    }
+        // predecessors, as edges pointing back to their source
+        std::vector<std::vector<coder_edge_t>> preds(sz);
+        std::vector<coder_edge_t> ee;
+        for (uint32_t n = 0; n < sz; n++) {
+            flow.successors(n, ee);
+            for (auto& e:ee) {
+                if (e.to < sz) preds[e.to].push_back(coder_edge_t{n, e.defs});
+            }
+        }
 
-    void emit_op_fail(const label_t l) {
-        emit_op(OP_FAIL);
-        emit_lbl(l);
-    }
+        // liveness
+        std::vector<std::vector<bool>> live(sz + 1, std::vector<bool>(registers, false));
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t n = sz; n-- > 0; ) {
+                flow.successors(n, ee);
+                std::vector<bool> l(registers, false);
+                for (auto& e:ee) {
+                    if (!e.defs) {
+                        for (reg_t r = 0; r < registers; r++) if (live[e.to][r]) l[r] = true;
+                    }
+                }
+                std::vector<bool> o(registers, false);
+                for (auto& e:ee) {
+                    if (e.defs) {
+                        for (reg_t r = 0; r < registers; r++) if (live[e.to][r]) o[r] = true;
+                    }
+                }
+                for (auto r:defs[n]) o[r] = false;
+                for (reg_t r = 0; r < registers; r++) if (o[r]) l[r] = true;
+                for (auto r:uses[n]) l[r] = true;
+                if (l != live[n]) {
+                    live[n] = l;
+                    changed = true;
+                }
+            }
+        }
 
-    void emit_op_return(const reg_t x) {
-        emit_op(OP_RETURN);
-        emit_reg(x);
-    }
+        // reaching definitions, unified into webs. definition 'r' is 
+        // the value register 'r' holds on entry
+        int ids = registers;
+        std::vector<std::vector<int>> def_ids(sz);
+        for (uint32_t n = 0; n < sz; n++) {
+            for (uint k = 0; k < defs[n].size(); k++) def_ids[n].push_back(ids++);
+        }
+        _parent = std::vector<int>(ids);
+        for (int n = 0; n < ids; n++) _parent[n] = n;
+
+        std::vector<std::vector<int>> in(sz, std::vector<int>(registers, -1));
+        changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t n = 0; n < sz; n++) {
+                std::vector<int> s(registers, -1);
+                if (n == 0) {
+                    for (reg_t r = 0; r < registers; r++) if (live[0][r]) s[r] = r;
+                }
+                for (auto& p:preds[n]) {
+                    for (reg_t r = 0; r < registers; r++) {
+                        if (!live[n][r]) continue;
+                        int d = in[p.to][r];
+                        if (p.defs) {
+                            for (uint k = 0; k < defs[p.to].size(); k++) {
+                                if (defs[p.to][k] == r) d = def_ids[p.to][k];
+                            }
+                        }
+                        if (d < 0) continue;
+                        if (s[r] < 0) {
+                            s[r] = d;
+                        } else if (find(s[r]) != find(d)) {
+                            unite(s[r], d);
+                            changed = true;
+                        }
+                    }
+                }
+                for (reg_t r = 0; r < registers; r++) {
+                    int a = (s[r] < 0) ? -1 : find(s[r]);
+                    int b = (in[n][r] < 0) ? -1 : find(in[n][r]);
+                    if (a != b) {
+                        in[n][r] = s[r];
+                        changed = true;
+                    }
+                }
+            }
+        }
 
-    void emit_label(const label_t l) {
-        _labels[l] = _code.size();
-    }
+        // number the webs
+        std::vector<int> web_of(ids, -1);
+        int webs = 0;
+        auto web = [&](int d) {
+            int f = find(d);
+            if (web_of[f] < 0) web_of[f] = webs++;
+            return web_of[f];
+        };
+        std::vector<std::vector<int>> def_webs(sz), use_webs(sz);
+        for (uint32_t n = 0; n < sz; n++) {
+            for (auto d:def_ids[n]) def_webs[n].push_back(web(d));
+            for (auto r:uses[n]) {
+                int d = in[n][r];
+                use_webs[n].push_back(web(d < 0 ? r : d));
+            }
+        }
+        int frame = web(in[0][0] < 0 ? 0 : in[0][0]);
+
+        // webs in a range are placed in one block
+        _block_of = std::vector<int>(webs, -1);
+        _offset   = std::vector<int>(webs, 0);
+        _blocks.clear();
+        for (uint32_t n = 0; n < sz; n++) {
+            auto& i = ii[n];
+            if ((i.op == OP_TAKEX || i.op == OP_SPLIT || i.op == OP_JNX || i.op == OP_JNS) && 
+                def_webs[n].size() > 1) {
+                if (!place(def_webs[n])) return registers;
+            } else if (i.op == OP_ARRAY && use_webs[n].size() > 1) {
+                if (!place(use_webs[n])) return registers;
+            } else if (i.op == OP_TAIL && use_webs[n].size() > 2) {
+                if (!place(std::vector<int>(use_webs[n].begin() + 1, use_webs[n].end()))) return registers;
+            }
+        }
+        for (int w = 0; w < webs; w++) {
+            if (_block_of[w] < 0) place(std::vector<int>{w});
+        }
 
-    void relabel() {
+        // live intervals of the blocks
+        std::vector<Block> blocks(_blocks.size());
+        for (uint b = 0; b < _blocks.size(); b++) {
+            auto& m = _blocks[b];
+            if (m.empty()) continue;
+            blocks[b].lo = m.begin()->first;
+            blocks[b].hi = m.rbegin()->first;
+        }
+        // positions are counted in half steps, an instruction uses its
+        // operands at 2n and, unless it writes while it still reads,
+        // defines its result at 2n+1 in a register another web let go
+        for (uint32_t n = 0; n < sz; n++) {
+            auto op = ii[n].op;
+            bool late = (op == OP_NIL || op == OP_DATA || op == OP_MOV ||
+                         op == OP_ARRAY || op == OP_CONCATX || op == OP_REUSE ||
+                         OP_IS_ARITHMETIC(op) || OP_IS_COMPARISON(op));
+            for (auto w:def_webs[n]) blocks[_block_of[w]].mention(late ? 2*n + 1 : 2*n);
+            for (auto w:use_webs[n]) blocks[_block_of[w]].mention(2*n);
+        }
+        // registers read before written hold their entry value, which is
+        // the frame or null, from the start
+        blocks[_block_of[frame]].mention(0);
+        for (reg_t r = 0; r < registers; r++) {
+            if (web_of[find(r)] >= 0) blocks[_block_of[web_of[find(r)]]].mention(0);
+        }
 
-        uint32_t    pc = 0;
+        changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t n = 0; n < sz; n++) {
+                flow.successors(n, ee);
+                for (auto& e:ee) {
+                    if (e.to > n) continue;
+                    uint32_t t = 2*e.to;
+                    uint32_t f = 2*n + 1;
+                    for (auto& b:blocks) {
+                        if (b.used() && b.start <= f && b.end >= t && (b.start > t || b.end < f)) {
+                            b.start = std::min(b.start, t);
+                            b.end   = std::max(b.end, f);
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
 
-        while (pc < _code.size()) {
-            switch (_code[pc]) {
+        // linear scan over the blocks ordered by start, the frame first
+        std::vector<int> order;
+        for (uint n = 0; n < blocks.size(); n++) {
+            if (blocks[n].used()) order.push_back(n);
+        }
+        int fb = _block_of[frame];
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            if (a == fb || b == fb) return (a == fb) && (b != fb);
+            return blocks[a].start < blocks[b].start;
+        });
+
+        std::vector<uint32_t> busy; // per register, the end of its interval + 1
+        std::vector<int> base(blocks.size(), 0);
+        uint32_t used = 0;
+        for (auto n:order) {
+            auto& b = blocks[n];
+            uint32_t w = b.hi - b.lo + 1;
+            uint32_t p = 0;
+            if (reuse) {
+                while (true) {
+                    bool fits = true;
+                    for (uint32_t q = p; q < p + w && q < busy.size(); q++) {
+                        if (busy[q] > b.start) {
+                            fits = false;
+                            p = q + 1;
+                            break;
+                        }
+                    }
+                    if (fits) break;
+                }
+            } else {
+                p = used;
+            }
+            if (busy.size() < p + w) busy.resize(p + w, 0);
+            for (uint32_t q = p; q < p + w; q++) busy[q] = b.end + 1;
+            base[n] = p - b.lo;
+            if (p + w > used) used = p + w;
+        }
+        if (used > UINT16_MAX) return registers;
+
+        // rewrite the operands
+        auto reg = [&](int w) {
+            return (reg_t) (base[_block_of[w]] + _offset[w]);
+        };
+        for (uint32_t n = 0; n < sz; n++) {
+            auto& i  = ii[n];
+            auto& dd = def_webs[n];
+            auto& uu = use_webs[n];
+            switch (i.op) {
             case OP_NIL:
-                pc += OP_SIZE + 1*OP_REG_SIZE;
+            case OP_DATA:
+                i.x = reg(dd[0]);
                 break;
             case OP_MOV:
-                pc += OP_SIZE + 2*OP_REG_SIZE;
-                break;
-            case OP_DATA:
-                pc += OP_SIZE + 1*OP_REG_SIZE + OP_INT_SIZE;
+                i.x = reg(dd[0]);
+                i.y = reg(uu[0]);
                 break;
             case OP_SET:
-                pc += OP_SIZE + 3*OP_REG_SIZE;
-                break;
+            case OP_CONCATX:
+            case OP_REUSE:
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+            case OP_LT:
+            case OP_LE:
+            case OP_EQ:
+            case OP_NE:
+                if (!dd.empty()) {
+                    i.x = reg(dd[0]);
+                    i.y = reg(uu[0]);
+                    i.z = reg(uu[1]);
+                } else {
+                    i.x = reg(uu[0]);
+                    i.y = reg(uu[1]);
+                    i.z = reg(uu[2]);
+                }
+                break;
+            case OP_TAKEX:
+            case OP_SPLIT:
+            case OP_JNX:
+            case OP_JNS:
+                if (dd.empty()) {
+                    i.x = 1; i.y = 0;
+                } else {
+                    i.x = reg(dd.front());
+                    i.y = reg(dd.back());
+                }
+                i.z = reg(uu[0]);
+                break;
+            case OP_ARRAY:
+                i.x = reg(dd[0]);
+                if (uu.empty()) {
+                    i.y = 1; i.z = 0;
+                } else {
+                    i.y = reg(uu.front());
+                    i.z = reg(uu.back());
+                }
+                break;
+            case OP_TAIL:
+                i.x = reg(uu[0]);
+                if (uu.size() == 1) {
+                    i.y = 1; i.z = 0;
+                } else {
+                    i.y = reg(uu[1]);
+                    i.z = reg(uu.back());
+                }
+                break;
+            case OP_TEST:
+            case OP_TAG:
+            case OP_JNE:
+            case OP_JNT:
+                i.x = reg(uu[0]);
+                i.y = reg(uu[1]);
+                break;
+            case OP_FAIL:
+            case OP_JMP:
+                break;
+            case OP_JNA:
+            case OP_SWITCH:
+            case OP_RETURN:
+                i.x = reg(uu[0]);
+                break;
+            }
+        }
+
+        if (reuse && flow.forward()) remove_nils();
+        remove_moves();
+
+        return (used == 0) ? 1 : used;
+    }
+
+private:
+    struct Block {
+        Block()
+            : lo(0), hi(0), start(UINT32_MAX), end(0) {
+        }
+
+        bool used() const {
+            return start != UINT32_MAX;
+        }
+
+        void mention(uint32_t n) {
+            start = std::min(start, n);
+            end   = std::max(end, n);
+        }
+
+        int         lo;
+        int         hi;
+        uint32_t    start;
+        uint32_t    end;
+    };
+
+    int find(int d) {
+        while (_parent[d] != d) {
+            _parent[d] = _parent[_parent[d]];
+            d = _parent[d];
+        }
+        return d;
+    }
+
+    void unite(int a, int b) {
+        _parent[find(a)] = find(b);
+    }
+
+    // place webs ww at consecutive offsets in one block, merging the
+    // blocks they are in; fails on conflicting placements
+    bool place(const std::vector<int>& ww) {
+        int b = -1, base = 0;
+        for (uint j = 0; j < ww.size(); j++) {
+            if (_block_of[ww[j]] >= 0) {
+                b = _block_of[ww[j]];
+                base = _offset[ww[j]] - (int) j;
+                break;
+            }
+        }
+        if (b < 0) {
+            b = _blocks.size();
+            _blocks.push_back(std::map<int, int>());
+        }
+        for (uint j = 0; j < ww.size(); j++) {
+            int w = ww[j];
+            int o = base + (int) j;
+            if (_block_of[w] == b) {
+                if (_offset[w] != o) return false;
+            } else if (_block_of[w] >= 0) {
+                int c = _block_of[w];
+                int shift = o - _offset[w];
+                for (auto& p:_blocks[c]) {
+                    auto q = _blocks[b].find(p.first + shift);
+                    if (q != _blocks[b].end() && q->second != p.second) return false;
+                }
+                for (auto& p:_blocks[c]) {
+                    _blocks[b][p.first + shift] = p.second;
+                    _block_of[p.second] = b;
+                    _offset[p.second] = p.first + shift;
+                }
+                _blocks[c].clear();
+            } else {
+                auto q = _blocks[b].find(o);
+                if (q != _blocks[b].end() && q->second != w) return false;
+                _blocks[b][o] = w;
+                _block_of[w] = b;
+                _offset[w] = o;
+            }
+        }
+        return true;
+    }
+
+    // a register window starts out cleared, so clearing a register
+    // which wasn't written on any path before is a no-op
+    void remove_nils() {
+        auto& ii = _program.instructions;
+        std::vector<bool> written;
+        std::vector<reg_t> defs, uses;
+        std::vector<bool> drop(ii.size(), false);
+        for (uint32_t n = 0; n < ii.size(); n++) {
+            auto& i = ii[n];
+            if (i.op == OP_NIL && i.x != 0 && (i.x >= written.size() || !written[i.x])) {
+                drop[n] = true;
+                continue;
+            }
+            instruction_registers(i, defs, uses);
+            for (auto r:defs) {
+                if (r >= written.size()) written.resize(r + 1, false);
+                written[r] = true;
+            }
+        }
+        program_erase(_program, drop);
+    }
+
+    // moves into the register read from are no-ops
+    void remove_moves() {
+        auto& ii = _program.instructions;
+        std::vector<bool> drop(ii.size(), false);
+        for (uint32_t n = 0; n < ii.size(); n++) {
+            drop[n] = (ii[n].op == OP_MOV) && (ii[n].x == ii[n].y);
+        }
+        program_erase(_program, drop);
+    }
+
+    Program&                        _program;
+    std::vector<int>                _parent;
+    std::vector<int>                _block_of;
+    std::vector<int>                _offset;
+    std::vector<std::map<int, int>> _blocks;
+};
+
+// peephole optimization, best run on a program where every web has a
+// register of its own. definitions are retargeted to the register they
+// are moved to, moves are propagated into their uses, constants loaded
+// more than once are hoisted to the prologue, and loads nobody reads
+// are removed. all of it relies on the code only jumping forward
+class Peephole {
+public:
+    Peephole(Program& p)
+        : _program(p), _registers(0) {
+    }
+
+    // returns the number of registers used after optimization
+    reg_t optimize(const reg_t registers) {
+        auto& ii = _program.instructions;
+        ControlFlow flow(_program);
+        if (ii.empty() || !flow.forward()) return registers;
+
+        _registers = registers;
+        analyze(flow);
+
+        _drop = std::vector<bool>(ii.size(), false);
+        retarget(flow);
+        propagate();
+        auto hoisted = hoist();
+        eliminate();
+        program_erase(_program, _drop);
+
+        ii.insert(ii.begin(), hoisted.begin(), hoisted.end());
+        for (auto& l:_program.labels) l.second += hoisted.size();
+
+        return _registers;
+    }
+
+    // fuse a test, tag, takex or split and the fail after it into one
+    // conditional branch
+    void fuse() {
+        auto& ii = _program.instructions;
+        ControlFlow flow(_program);
+        std::vector<bool> drop(ii.size(), false);
+        for (uint32_t n = 0; n + 1 < ii.size(); n++) {
+            auto& i = ii[n];
+            auto& j = ii[n + 1];
+            if (j.op != OP_FAIL || flow.labeled(n + 1)) continue;
+            switch (i.op) {
+            case OP_TEST:
+                i.op = OP_JNE;
+                break;
+            case OP_TAG:
+                i.op = OP_JNT;
+                break;
+            case OP_TAKEX:
+                i.op = OP_JNX;
+                break;
+            case OP_SPLIT:
+                i.op = OP_JNS;
+                break;
+            default:
+                continue;
+            }
+            i.n = j.n;
+            drop[n + 1] = true;
+            n++;
+        }
+        program_erase(_program, drop);
+    }
+
+private:
+    // definitions and uses per register, registers defined or used in a
+    // range, and registers which may be read before they are written
+    void analyze(const ControlFlow& flow) {
+        auto& ii = _program.instructions;
+        uint32_t sz = ii.size();
+
+        _defs     = std::vector<std::vector<uint32_t>>(_registers);
+        _uses     = std::vector<std::vector<uint32_t>>(_registers);
+        _ranged   = std::vector<bool>(_registers, false);
+        _unsafe   = std::vector<bool>(_registers, false);
+
+        std::vector<reg_t> defs, uses;
+        for (uint32_t n = 0; n < sz; n++) {
+            auto& i = ii[n];
+            instruction_registers(i, defs, uses);
+            for (auto r:defs) _defs[r].push_back(n);
+            for (auto r:uses) _uses[r].push_back(n);
+            if (i.op == OP_TAKEX || i.op == OP_SPLIT) {
+                for (auto r:defs) _ranged[r] = true;
+            } else if (i.op == OP_ARRAY) {
+                for (auto r:uses) _ranged[r] = true;
+            } else if (i.op == OP_TAIL) {
+                for (uint n = 1; n < uses.size(); n++) _ranged[uses[n]] = true;
+            }
+        }
+
+        // registers surely written, the frame is there on entry. since
+        // the code only jumps forward all predecessors are seen first
+        std::vector<std::vector<bool>> written(sz + 1);
+        written[0] = std::vector<bool>(_registers, false);
+        written[0][0] = true;
+        std::vector<coder_edge_t> ee;
+        for (uint32_t n = 0; n < sz; n++) {
+            if (written[n].empty()) continue;
+            instruction_registers(ii[n], defs, uses);
+            for (auto r:uses) {
+                if (!written[n][r]) _unsafe[r] = true;
+            }
+            flow.successors(n, ee);
+            for (auto& e:ee) {
+                auto w = written[n];
+                if (e.defs) {
+                    for (auto r:defs) w[r] = true;
+                }
+                if (written[e.to].empty()) {
+                    written[e.to] = w;
+                } else {
+                    for (reg_t r = 0; r < _registers; r++) {
+                        written[e.to][r] = written[e.to][r] && w[r];
+                    }
+                }
+            }
+            written[n] = std::vector<bool>();
+        }
+    }
+
+    // 'd r0 ..; .. mov r1 r0' becomes 'd r1 ..' when that is the only
+    // use of r0 and nothing in between jumps, or is jumped to, or
+    // touches r1
+    void retarget(const ControlFlow& flow) {
+        auto& ii = _program.instructions;
+        for (uint32_t m = 0; m < ii.size(); m++) {
+            auto& i = ii[m];
+            if (i.op != OP_MOV || i.x == i.y) continue;
+            reg_t r1 = i.x;
+            reg_t r0 = i.y;
+            if (_defs[r0].size() != 1 || _uses[r0].size() != 1 || _defs[r1].size() != 1) continue;
+            uint32_t d = _defs[r0][0];
+            if (d >= m) continue;
+            auto& j = ii[d];
+            if (j.op != OP_NIL && j.op != OP_DATA && j.op != OP_MOV && 
+                j.op != OP_ARRAY && j.op != OP_CONCATX && j.op != OP_REUSE &&
+                !OP_IS_ARITHMETIC(j.op) && !OP_IS_COMPARISON(j.op)) continue;
+            if (mentions(j, r1)) continue;
+            bool block = true;
+            for (uint32_t k = d + 1; k <= m && block; k++) {
+                if (flow.labeled(k)) block = false;
+            }
+            for (uint32_t k = d + 1; k < m && block; k++) {
+                if (_drop[k]) continue;
+                if (jumps(ii[k].op) || mentions(ii[k], r1)) block = false;
+            }
+            if (!block) continue;
+
+            j.x = r1;
+            _drop[m] = true;
+            _defs[r1] = std::vector<uint32_t>{d};
+            _defs[r0].clear();
+            _uses[r0].clear();
+        }
+    }
+
+    // 'mov r1 r0' is removed and r0 read in its stead when r1 isn't part 
+    // of a range and r0 isn't written anymore
+    void propagate() {
+        auto& ii = _program.instructions;
+        for (uint32_t m = 0; m < ii.size(); m++) {
+            auto& i = ii[m];
+            if (_drop[m] || i.op != OP_MOV || i.x == i.y) continue;
+            reg_t r1 = i.x;
+            reg_t r0 = i.y;
+            if (_defs[r1].size() != 1 || _ranged[r1] || _unsafe[r1] || _uses[r1].empty()) continue;
+            bool after = false;
+            for (auto d:_defs[r0]) {
+                if (d > m) after = true;
+            }
+            if (after) continue;
+
+            auto& uu = _uses[r0];
+            uu.erase(std::find(uu.begin(), uu.end(), m));
+            for (auto u:_uses[r1]) {
+                rename(ii[u], r1, r0);
+                uu.push_back(u);
+            }
+            _drop[m] = true;
+            _defs[r1].clear();
+            _uses[r1].clear();
+        }
+    }
+
+    // constants loaded into several registers read outside of ranges
+    // are loaded once, up front
+    CoderInstructions hoist() {
+        auto& ii = _program.instructions;
+        std::map<uint32_t, std::vector<reg_t>> loads;
+        for (reg_t r = 0; r < _registers; r++) {
+            if (_defs[r].size() != 1 || _ranged[r] || _unsafe[r] || _uses[r].empty()) continue;
+            auto d = _defs[r][0];
+            if (ii[d].op == OP_DATA) loads[ii[d].n].push_back(r);
+        }
+
+        CoderInstructions hoisted;
+        for (auto& l:loads) {
+            if (l.second.size() < 2 || _registers == UINT16_MAX) continue;
+            reg_t h = _registers++;
+            hoisted.push_back(coder_instruction_t{OP_DATA, h, 0, 0, 0, l.first});
+            _defs.push_back(std::vector<uint32_t>());
+            _uses.push_back(std::vector<uint32_t>());
+            for (auto r:l.second) {
+                _drop[_defs[r][0]] = true;
+                for (auto u:_uses[r]) {
+                    rename(ii[u], r, h);
+                    _uses[h].push_back(u);
+                }
+                _defs[r].clear();
+                _uses[r].clear();
+            }
+        }
+        return hoisted;
+    }
+
+    // remove loads and moves into registers nobody reads
+    void eliminate() {
+        auto& ii = _program.instructions;
+        for (uint32_t n = ii.size(); n-- > 0; ) {
+            auto& i = ii[n];
+            if (_drop[n]) continue;
+            if (i.op != OP_NIL && i.op != OP_DATA && i.op != OP_MOV) continue;
+            if (!_uses[i.x].empty() || i.x == 0) continue;
+            if (i.op == OP_MOV) {
+                auto& uu = _uses[i.y];
+                uu.erase(std::find(uu.begin(), uu.end(), n));
+            }
+            _drop[n] = true;
+        }
+    }
+
+    // the instructions which may jump before the fusion of fails
+    static bool jumps(const opcode_t op) {
+        return op == OP_FAIL || op == OP_SWITCH || op == OP_JMP || op == OP_JNA || OP_IS_ARITHMETIC(op);
+    }
+
+    static bool mentions(const coder_instruction_t& i, const reg_t r) {
+        std::vector<reg_t> defs, uses;
+        instruction_registers(i, defs, uses);
+        return (std::find(defs.begin(), defs.end(), r) != defs.end()) ||
+               (std::find(uses.begin(), uses.end(), r) != uses.end());
+    }
+
+    // rename a use outside of a range
+    static void rename(coder_instruction_t& i, const reg_t r0, const reg_t r1) {
+        switch (i.op) {
+        case OP_MOV:
+            if (i.y == r0) i.y = r1;
+            break;
+        case OP_SET:
+            if (i.x == r0) i.x = r1;
+            if (i.y == r0) i.y = r1;
+            if (i.z == r0) i.z = r1;
+            break;
+        case OP_TAKEX:
+        case OP_SPLIT:
+        case OP_JNX:
+        case OP_JNS:
+            if (i.z == r0) i.z = r1;
+            break;
+        case OP_CONCATX:
+        case OP_REUSE:
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_LT:
+        case OP_LE:
+        case OP_EQ:
+        case OP_NE:
+            if (i.y == r0) i.y = r1;
+            if (i.z == r0) i.z = r1;
+            break;
+        case OP_TEST:
+        case OP_TAG:
+        case OP_JNE:
+        case OP_JNT:
+            if (i.x == r0) i.x = r1;
+            if (i.y == r0) i.y = r1;
+            break;
+        case OP_JNA:
+        case OP_SWITCH:
+        case OP_TAIL:
+        case OP_RETURN:
+            if (i.x == r0) i.x = r1;
+            break;
+        default:
+            break;
+        }
+    }
+
+    Program&                            _program;
+    reg_t                               _registers;
+    std::vector<std::vector<uint32_t>>  _defs;
+    std::vector<std::vector<uint32_t>>  _uses;
+    std::vector<bool>                   _ranged;
+    std::vector<bool>                   _unsafe;
+    std::vector<bool>                   _drop;
+};
+
+class Coder {
+public:
+    Coder(): 
+        _code(Code()),
+        _label_counter(0),
+        _register_counter(0),
+        _register_max(0),
+        _index_counter(0),
+        _labels(Labels()) {
+    }
+
+    Code code() {
+        // can only be called once
+        optimize();
+        relabel();
+        return _code;
+    }
+
+    void reset() {
+        _code = Code();
+        _label_counter = 0;
+        _register_counter = 0;
+        _register_max = 0;
+        _index_counter = 0;
+        _labels = Labels();
+    }
+
+    label_t generate_label() {
+        label_t l = _label_counter;
+        _label_counter++;
+        return l;
+    }
+    
+    reg_t generate_index() {
+        reg_t r = _index_counter;
+        _index_counter++;
+        return r;
+    }
+
+    reg_t generate_register() {
+        reg_t r = _register_counter;
+        _register_counter++;
+        if (_register_counter > _register_max) _register_max = _register_counter;
+        return r;
+    }
+
+    // the number of registers the emitted code uses
+    reg_t registers() const {
+        return _register_max;
+    }
+
+    reg_t peek_register() const {
+        return _register_counter;
+    }
+
+    void restore_register(reg_t r) {
+        _register_counter = r;
+    }
+
+    // primitive byte emit
+    void emit_i8(uint8_t b) {
+        _code.push_back(b);
+    }
+
+    void emit_i16(uint16_t n) {
+        // don't use typecasts, this is portable
+        _code.push_back( (n >> 8) & 0xFF );
+        _code.push_back( n & 0xFF );
+    }
+
+    void emit_i32(uint32_t n) {
+        _code.push_back( (n >> 24) & 0xFF );
+        _code.push_back( (n >> 16) & 0xFF );
+        _code.push_back( (n >> 8) & 0xFF );
+        _code.push_back( n & 0xFF );
+    }
+
+    void emit_op(const opcode_t op) {
+        emit_i8(op);
+    }
+
+    void emit_reg(const reg_t r) {
+        emit_i16(r);
+    }
+
+    void emit_lbl(const label_t l) {
+        emit_i32(l);
+    }
+
+    void emit_idx(const index_t i) {
+        emit_i16((uint16_t) i);
+    }
+
+    // bytecode emit
+    void emit_op_nil(const reg_t x) {
+        emit_op(OP_NIL);
+        emit_reg(x);
+    }
+
+    void emit_op_mov(const reg_t x, const reg_t y) {
+        emit_op(OP_MOV);
+        emit_reg(x);
+        emit_reg(y);
+    }
+
+    void emit_op_data(const reg_t x, const uint32_t i32) {
+        emit_op(OP_DATA);
+        emit_reg(x);
+        emit_i32(i32);
+    }
+
+    void emit_op_set(const reg_t x, const reg_t y, const reg_t z) {
+        emit_op(OP_SET);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+    }
+
+    void emit_op_takex(const reg_t x, const reg_t y, const reg_t z, const index_t i) {
+        emit_op(OP_TAKEX);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+        emit_idx(i);
+    }
+
+    void emit_op_split(const reg_t x, const reg_t y, const reg_t z) {
+        emit_op(OP_SPLIT);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+    }
+
+    void emit_op_array(const reg_t x, const reg_t y, const reg_t z) {
+        emit_op(OP_ARRAY);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+    }
+
+    void emit_op_concatx(const reg_t x, const reg_t y, const reg_t z, const reg_t i) {
+        emit_op(OP_CONCATX);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+        emit_reg(i);
+    }
+
+    void emit_op_test(const reg_t x, const reg_t y) {
+        emit_op(OP_TEST);
+        emit_reg(x);
+        emit_reg(y);
+    }
+
+    void emit_op_tag(const reg_t x, const reg_t y) {
+        emit_op(OP_TAG);
+        emit_reg(x);
+        emit_reg(y);
+    }
+
+    void emit_op_fail(const label_t l) {
+        emit_op(OP_FAIL);
+        emit_lbl(l);
+    }
+
+    void emit_op_jne(const reg_t x, const reg_t y, const label_t l) {
+        emit_op(OP_JNE);
+        emit_reg(x);
+        emit_reg(y);
+        emit_lbl(l);
+    }
+
+    void emit_op_jnt(const reg_t x, const reg_t y, const label_t l) {
+        emit_op(OP_JNT);
+        emit_reg(x);
+        emit_reg(y);
+        emit_lbl(l);
+    }
+
+    void emit_op_jnx(const reg_t x, const reg_t y, const reg_t z, const index_t i, const label_t l) {
+        emit_op(OP_JNX);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+        emit_idx(i);
+        emit_lbl(l);
+    }
+
+    void emit_op_jns(const reg_t x, const reg_t y, const reg_t z, const label_t l) {
+        emit_op(OP_JNS);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+        emit_lbl(l);
+    }
+
+    void emit_op_switch(const reg_t x, const switch_kind_t k, const SwitchCases& cc, const label_t l) {
+        emit_op(OP_SWITCH);
+        emit_reg(x);
+        emit_i16(k);
+        emit_i16(cc.size());
+        emit_lbl(l);
+        for (auto& c:cc) {
+            emit_i32((uint32_t) ((uint64_t) c.first >> 32));
+            emit_i32((uint32_t) c.first);
+            emit_lbl(c.second);
+        }
+    }
+
+    void emit_op_tail(const reg_t x, const reg_t y, const reg_t z) {
+        emit_op(OP_TAIL);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+    }
+
+    void emit_op_reuse(const reg_t x, const reg_t y, const reg_t z, const reg_t i) {
+        emit_op(OP_REUSE);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+        emit_reg(i);
+    }
+
+    void emit_op_jmp(const label_t l) {
+        emit_op(OP_JMP);
+        emit_lbl(l);
+    }
+
+    void emit_op_jna(const reg_t x, const index_t i, const label_t l) {
+        emit_op(OP_JNA);
+        emit_reg(x);
+        emit_idx(i);
+        emit_lbl(l);
+    }
+
+    // arithmetic, which jumps to l when the builtin should handle it
+    void emit_op_arithmetic(const opcode_t op, const reg_t x, const reg_t y, const reg_t z, const label_t l) {
+        emit_op(op);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+        emit_lbl(l);
+    }
+
+    void emit_op_comparison(const opcode_t op, const reg_t x, const reg_t y, const reg_t z) {
+        emit_op(op);
+        emit_reg(x);
+        emit_reg(y);
+        emit_reg(z);
+    }
+
+    void emit_op_return(const reg_t x) {
+        emit_op(OP_RETURN);
+        emit_reg(x);
+    }
+
+    void emit_label(const label_t l) {
+        _labels[l] = _code.size();
+    }
+
+    // the emitted code as a program, labels point at instructions
+    Program program() const {
+        Program p;
+        std::map<uint32_t, uint32_t> index;
+        uint32_t pc = 0;
+        while (pc < _code.size()) {
+            index[pc] = p.instructions.size();
+            coder_instruction_t i = { (opcode_t) _code[pc], 0, 0, 0, 0, 0 };
+            pc += OP_SIZE;
+            switch (i.op) {
+            case OP_NIL:
+            case OP_RETURN:
+                i.x = read_i16(pc);
+                break;
+            case OP_MOV:
+            case OP_TEST:
+            case OP_TAG:
+                i.x = read_i16(pc);
+                i.y = read_i16(pc);
+                break;
+            case OP_DATA:
+                i.x = read_i16(pc);
+                i.n = read_i32(pc);
+                break;
+            case OP_SET:
+            case OP_SPLIT:
+            case OP_ARRAY:
+            case OP_TAIL:
+            case OP_LT:
+            case OP_LE:
+            case OP_EQ:
+            case OP_NE:
+                i.x = read_i16(pc);
+                i.y = read_i16(pc);
+                i.z = read_i16(pc);
+                break;
+            case OP_TAKEX:
+            case OP_CONCATX:
+            case OP_REUSE:
+                i.x = read_i16(pc);
+                i.y = read_i16(pc);
+                i.z = read_i16(pc);
+                i.i = read_i16(pc);
+                break;
+            case OP_FAIL:
+            case OP_JMP:
+                i.n = read_i32(pc);
+                break;
+            case OP_JNA:
+                i.x = read_i16(pc);
+                i.i = read_i16(pc);
+                i.n = read_i32(pc);
+                break;
+            case OP_JNE:
+            case OP_JNT:
+                i.x = read_i16(pc);
+                i.y = read_i16(pc);
+                i.n = read_i32(pc);
+                break;
+            case OP_JNX:
+                i.x = read_i16(pc);
+                i.y = read_i16(pc);
+                i.z = read_i16(pc);
+                i.i = read_i16(pc);
+                i.n = read_i32(pc);
+                break;
+            case OP_JNS:
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                i.x = read_i16(pc);
+                i.y = read_i16(pc);
+                i.z = read_i16(pc);
+                i.n = read_i32(pc);
+                break;
+            case OP_SWITCH: {
+                coder_switch_t sw;
+                i.x = read_i16(pc);
+                sw.kind = (switch_kind_t) read_i16(pc);
+                auto n = read_i16(pc);
+                i.n = read_i32(pc);
+                for (uint16_t j = 0; j < n; j++) {
+                    uint64_t c = read_i32(pc);
+                    c = (c << 32) | read_i32(pc);
+                    sw.cases.push_back(std::make_pair((int64_t) c, (label_t) read_i32(pc)));
+                }
+                i.i = p.switches.size();
+                p.switches.push_back(sw);
+                }
+                break;
+            }
+            p.instructions.push_back(i);
+        }
+        index[pc] = p.instructions.size();
+        for (auto& l:_labels) {
+            p.labels[l.first] = index[l.second];
+        }
+        return p;
+    }
+
+    // replace the emitted code with a program
+    void assemble(const Program& p) {
+        _code = Code();
+        std::vector<uint32_t> offset;
+        for (auto& i:p.instructions) {
+            offset.push_back(_code.size());
+            switch (i.op) {
+            case OP_NIL:
+                emit_op_nil(i.x);
+                break;
+            case OP_MOV:
+                emit_op_mov(i.x, i.y);
+                break;
+            case OP_DATA:
+                emit_op_data(i.x, i.n);
+                break;
+            case OP_SET:
+                emit_op_set(i.x, i.y, i.z);
+                break;
+            case OP_TAKEX:
+                emit_op_takex(i.x, i.y, i.z, i.i);
+                break;
+            case OP_SPLIT:
+                emit_op_split(i.x, i.y, i.z);
+                break;
+            case OP_ARRAY:
+                emit_op_array(i.x, i.y, i.z);
+                break;
+            case OP_CONCATX:
+                emit_op_concatx(i.x, i.y, i.z, i.i);
+                break;
+            case OP_REUSE:
+                emit_op_reuse(i.x, i.y, i.z, i.i);
+                break;
+            case OP_TEST:
+                emit_op_test(i.x, i.y);
+                break;
+            case OP_TAG:
+                emit_op_tag(i.x, i.y);
+                break;
+            case OP_FAIL:
+                emit_op_fail(i.n);
+                break;
+            case OP_JNE:
+                emit_op_jne(i.x, i.y, i.n);
+                break;
+            case OP_JNT:
+                emit_op_jnt(i.x, i.y, i.n);
+                break;
+            case OP_JNX:
+                emit_op_jnx(i.x, i.y, i.z, i.i, i.n);
+                break;
+            case OP_JNS:
+                emit_op_jns(i.x, i.y, i.z, i.n);
+                break;
+            case OP_SWITCH: {
+                auto& sw = p.switches[i.i];
+                emit_op_switch(i.x, sw.kind, sw.cases, i.n);
+                }
+                break;
+            case OP_TAIL:
+                emit_op_tail(i.x, i.y, i.z);
+                break;
+            case OP_JMP:
+                emit_op_jmp(i.n);
+                break;
+            case OP_JNA:
+                emit_op_jna(i.x, i.i, i.n);
+                break;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                emit_op_arithmetic(i.op, i.x, i.y, i.z, i.n);
+                break;
+            case OP_LT:
+            case OP_LE:
+            case OP_EQ:
+            case OP_NE:
+                emit_op_comparison(i.op, i.x, i.y, i.z);
+                break;
+            case OP_RETURN:
+                emit_op_return(i.x);
+                break;
+            }
+        }
+        offset.push_back(_code.size());
+        _labels = Labels();
+        for (auto& l:p.labels) {
+            _labels[l.first] = offset[l.second];
+        }
+    }
+
+    // webs are renamed apart, the peephole pass cleans up, registers 
+    // are allocated, and finally tests and fails are fused
+    void optimize() {
+        auto p = program();
+        auto r = RegisterAllocator(p).allocate(_register_max, false);
+        r = Peephole(p).optimize(r);
+        _register_max = RegisterAllocator(p).allocate(r);
+        Peephole(p).fuse();
+        assemble(p);
+    }
+
+
+    void relabel() {
+
+        uint32_t    pc = 0;
+
+        while (pc < _code.size()) {
+            switch (_code[pc]) {
+            case OP_NIL:
+                pc += OP_SIZE + 1*OP_REG_SIZE;
+                break;
+            case OP_MOV:
+                pc += OP_SIZE + 2*OP_REG_SIZE;
+                break;
+            case OP_DATA:
+                pc += OP_SIZE + 1*OP_REG_SIZE + OP_INT_SIZE;
+                break;
+            case OP_SET:
+                pc += OP_SIZE + 3*OP_REG_SIZE;
+                break;
             case OP_TAKEX:
             case OP_CONCATX:
+            case OP_REUSE:
                 pc += OP_SIZE + 3*OP_REG_SIZE + OP_INDEX_SIZE;
                 break;
             case OP_SPLIT:
             case OP_ARRAY:
+            case OP_TAIL:
+            case OP_LT:
+            case OP_LE:
+            case OP_EQ:
+            case OP_NE:
+                pc += OP_SIZE + 3*OP_REG_SIZE;
+                break;
+            case OP_TEST:
+            case OP_TAG:
+                pc += OP_SIZE + 2*OP_REG_SIZE;
+                break;
+            case OP_FAIL:
+            case OP_JMP:
+                pc += OP_SIZE;
+                relabel_at(pc);
+                pc += OP_LABEL_SIZE;
+                break;
+            case OP_JNA:
+                pc += OP_SIZE + OP_REG_SIZE + OP_INDEX_SIZE;
+                relabel_at(pc);
+                pc += OP_LABEL_SIZE;
+                break;
+            case OP_JNE:
+            case OP_JNT:
+                pc += OP_SIZE + 2*OP_REG_SIZE;
+                relabel_at(pc);
+                pc += OP_LABEL_SIZE;
+                break;
+            case OP_JNX:
+                pc += OP_SIZE + 3*OP_REG_SIZE + OP_INDEX_SIZE;
+                relabel_at(pc);
+                pc += OP_LABEL_SIZE;
+                break;
+            case OP_JNS:
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                pc += OP_SIZE + 3*OP_REG_SIZE;
+                relabel_at(pc);
+                pc += OP_LABEL_SIZE;
+                break;
+            case OP_SWITCH: {
+                pc += OP_SIZE + OP_REG_SIZE + OP_INDEX_SIZE;
+                uint16_t n = ( (_code[pc] << 8) | _code[pc+1] );
+                pc += OP_INDEX_SIZE;
+                relabel_at(pc);
+                pc += OP_LABEL_SIZE;
+                for (uint16_t i = 0; i < n; i++) {
+                    pc += 2*OP_INT_SIZE;
+                    relabel_at(pc);
+                    pc += OP_LABEL_SIZE;
+                }
+                }
+                break;
+            case OP_RETURN:
+                pc += OP_SIZE + 1*OP_REG_SIZE;
+                break;
+            }
+        }
+    }
+
+private:
+    void relabel_at(const uint32_t pc) {
+        uint32_t l0 = ( (_code[pc] << 24) | (_code[pc+1] << 16) | (_code[pc+2] << 8) |  _code[pc+3] );
+        uint32_t l1 = _labels[l0];
+        _code[pc+0] = ( (l1 >> 24) & 0xFF );
+        _code[pc+1] = ( (l1 >> 16) & 0xFF );
+        _code[pc+2] = ( (l1 >> 8) & 0xFF );
+        _code[pc+3] = ( l1 & 0xFF );
+    }
+
+    uint16_t read_i16(uint32_t& pc) const {
+        uint16_t n = ( (_code[pc] << 8) | _code[pc+1] );
+        pc += 2;
+        return n;
+    }
+
+    uint32_t read_i32(uint32_t& pc) const {
+        uint32_t n = ( (_code[pc] << 24) | (_code[pc+1] << 16) | (_code[pc+2] << 8) |  _code[pc+3] );
+        pc += 4;
+        return n;
+    }
+
+    Code        _code;
+    int         _label_counter;
+    int         _register_counter;
+    int         _register_max;
+    int         _index_counter;
+    Labels      _labels;
+};
+
+// rewrites the data indices and the symbols switched on in code, used
+// to move code between machines with different tables
+class Relocator {
+public:
+    Relocator(Code& code)
+        : _code(code) {
+    }
+
+    // false if the code is malformed
+    bool relocate(const std::function<uint32_t(uint32_t)>& data,
+                  const std::function<int64_t(int64_t)>& symbol) {
+        uint32_t pc = 0;
+        while (pc < _code.size()) {
+            switch (_code[pc]) {
+            case OP_NIL:
+            case OP_RETURN:
+                pc += OP_SIZE + 1*OP_REG_SIZE;
+                break;
+            case OP_MOV:
+            case OP_TEST:
+            case OP_TAG:
+                pc += OP_SIZE + 2*OP_REG_SIZE;
+                break;
+            case OP_DATA:
+                pc += OP_SIZE + 1*OP_REG_SIZE;
+                if (pc + OP_INT_SIZE > _code.size()) return false;
+                write_i32(pc, data(read_i32(pc)));
+                pc += OP_INT_SIZE;
+                break;
+            case OP_SET:
+            case OP_SPLIT:
+            case OP_ARRAY:
+            case OP_TAIL:
+            case OP_LT:
+            case OP_LE:
+            case OP_EQ:
+            case OP_NE:
                 pc += OP_SIZE + 3*OP_REG_SIZE;
                 break;
+            case OP_TAKEX:
+            case OP_CONCATX:
+            case OP_REUSE:
+                pc += OP_SIZE + 3*OP_REG_SIZE + OP_INDEX_SIZE;
+                break;
+            case OP_FAIL:
+            case OP_JMP:
+                pc += OP_SIZE + OP_LABEL_SIZE;
+                break;
+            case OP_JNA:
+                pc += OP_SIZE + OP_REG_SIZE + OP_INDEX_SIZE + OP_LABEL_SIZE;
+                break;
+            case OP_JNE:
+            case OP_JNT:
+                pc += OP_SIZE + 2*OP_REG_SIZE + OP_LABEL_SIZE;
+                break;
+            case OP_JNX:
+                pc += OP_SIZE + 3*OP_REG_SIZE + OP_INDEX_SIZE + OP_LABEL_SIZE;
+                break;
+            case OP_JNS:
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                pc += OP_SIZE + 3*OP_REG_SIZE + OP_LABEL_SIZE;
+                break;
+            case OP_SWITCH: {
+                pc += OP_SIZE + OP_REG_SIZE;
+                if (pc + 2*OP_INDEX_SIZE + OP_LABEL_SIZE > _code.size()) return false;
+                auto k = (switch_kind_t) ( (_code[pc] << 8) | _code[pc+1] );
+                pc += OP_INDEX_SIZE;
+                uint16_t n = ( (_code[pc] << 8) | _code[pc+1] );
+                pc += OP_INDEX_SIZE + OP_LABEL_SIZE;
+                for (uint16_t i = 0; i < n; i++) {
+                    if (pc + 2*OP_INT_SIZE + OP_LABEL_SIZE > _code.size()) return false;
+                    if (k == SWITCH_SYMBOL || k == SWITCH_TAG) {
+                        uint64_t c = read_i32(pc);
+                        c = (c << 32) | read_i32(pc + OP_INT_SIZE);
+                        c = (uint64_t) symbol((int64_t) c);
+                        write_i32(pc, (uint32_t) (c >> 32));
+                        write_i32(pc + OP_INT_SIZE, (uint32_t) c);
+                    }
+                    pc += 2*OP_INT_SIZE + OP_LABEL_SIZE;
+                }
+                }
+                break;
+            default:
+                return false;
+            }
+        }
+        return pc == _code.size();
+    }
+
+private:
+    uint32_t read_i32(const uint32_t pc) const {
+        return ( (_code[pc] << 24) | (_code[pc+1] << 16) | (_code[pc+2] << 8) |  _code[pc+3] );
+    }
+
+    void write_i32(const uint32_t pc, const uint32_t n) {
+        _code[pc+0] = ( (n >> 24) & 0xFF );
+        _code[pc+1] = ( (n >> 16) & 0xFF );
+        _code[pc+2] = ( (n >> 8) & 0xFF );
+        _code[pc+3] = ( n & 0xFF );
+    }
+
+    Code&       _code;
+};
+
+// a decoded instruction, operands are fixed width, labels are 
+// instruction indices and data is resolved to its slot
+typedef struct {
+    opcode_t            op;
+    reg_t               x;
+    reg_t               y;
+    reg_t               z;
+    index_t             i;
+    label_t             l;
+    const VMObjectPtr*  d;
+} instruction_t;
+
+typedef std::vector<instruction_t>  Instructions;
+
+// a decoded switch; small dense key ranges index a table, sparse ones 
+// are hashed, the labels are instruction indices
+class SwitchTable {
+public:
+    SwitchTable(const switch_kind_t k, const SwitchCases& cc, const label_t l)
+        : _kind(k), _low(0), _otherwise(l) {
+        if (cc.empty()) return;
+        int64_t lo = cc[0].first;
+        int64_t hi = cc[0].first;
+        for (auto& c:cc) {
+            lo = std::min(lo, c.first);
+            hi = std::max(hi, c.first);
+        }
+        // distances are taken unsigned, keys may span all of int64
+        uint64_t span = (uint64_t) hi - (uint64_t) lo;
+        if (span <= 2 * cc.size() + 8) {
+            _low = lo;
+            _dense = std::vector<label_t>(span + 1, l);
+            for (auto& c:cc) {
+                _dense[(uint64_t) c.first - (uint64_t) lo] = c.second;
+            }
+        } else {
+            for (auto& c:cc) {
+                _sparse[c.first] = c.second;
+            }
+        }
+    }
+
+    label_t lookup(const VMObjectPtr& x0) const {
+        int64_t k;
+        switch (_kind) {
+        case SWITCH_INTEGER:
+            if (x0->tag() != VM_OBJECT_INTEGER) return _otherwise;
+            k = VM_OBJECT_INTEGER_VALUE(x0);
+            break;
+        case SWITCH_CHAR:
+            if (x0->tag() != VM_OBJECT_CHAR) return _otherwise;
+            k = VM_OBJECT_CHAR_VALUE(x0);
+            break;
+        case SWITCH_SYMBOL:
+            if (x0->tag() != VM_OBJECT_COMBINATOR) return _otherwise;
+            k = x0->symbol();
+            break;
+        case SWITCH_TAG:
+            if (x0.is_integer()) {
+                k = SYMBOL_INT;
+            } else if (x0.is_char()) {
+                k = SYMBOL_CHAR;
+            } else {
+                k = x0->symbol();
+            }
+            break;
+        default:
+            return _otherwise;
+        }
+        if (!_dense.empty()) {
+            uint64_t n = (uint64_t) k - (uint64_t) _low;
+            return (n < _dense.size()) ? _dense[n] : _otherwise;
+        } else {
+            auto it = _sparse.find(k);
+            return (it == _sparse.end()) ? _otherwise : it->second;
+        }
+    }
+
+private:
+    switch_kind_t                           _kind;
+    int64_t                                 _low;
+    label_t                                 _otherwise;
+    std::vector<label_t>                    _dense;
+    std::unordered_map<int64_t, label_t>    _sparse;
+};
+
+typedef std::vector<SwitchTable>    SwitchTables;
+
+class Decoder {
+public:
+    Decoder(VM* m, const Code& code, const reg_t registers)
+        : _machine(m), _code(code), _registers(registers), _pc(0) {
+    }
+
+    uint16_t fetch_i16() {
+        uint16_t n = ( (_code[_pc] << 8) | _code[_pc+1] );
+        _pc += 2;
+        return n;
+    }
+
+    uint32_t fetch_i32() {
+        uint32_t n = ( (_code[_pc] << 24) | (_code[_pc+1] << 16) | (_code[_pc+2] << 8) |  _code[_pc+3] );
+        _pc += 4;
+        return n;
+    }
+
+    reg_t fetch_register() {
+        reg_t r = fetch_i16();
+        if (r >= _registers) PANIC("register out of window");
+        return r;
+    }
+
+    // switches are decoded once labels resolve to instruction indices
+    Instructions decode(SwitchTables& ss) {
+        Instructions ii;
+        std::vector<coder_switch_t> sws;
+        // byte offset to instruction index, for labels
+        std::vector<uint32_t> offsets(_code.size() + 1, 0);
+
+        _pc = 0;
+        while (_pc < _code.size()) {
+            offsets[_pc] = ii.size();
+
+            instruction_t i = { (opcode_t) _code[_pc], 0, 0, 0, 0, 0, nullptr };
+            _pc += OP_SIZE;
+            switch (i.op) {
+            case OP_NIL:
+            case OP_RETURN:
+                i.x = fetch_register();
+                break;
+            case OP_MOV:
             case OP_TEST:
             case OP_TAG:
-                pc += OP_SIZE + 2*OP_REG_SIZE;
+                i.x = fetch_register();
+                i.y = fetch_register();
                 break;
-            case OP_FAIL: {
-                pc += OP_SIZE;
-                uint32_t l0 = ( (_code[pc] << 24) | (_code[pc+1] << 16) | (_code[pc+2] << 8) |  _code[pc+3] );
-                uint32_t l1 = _labels[l0];
-                _code[pc+0] = ( (l1 >> 24) & 0xFF );
-                _code[pc+1] = ( (l1 >> 16) & 0xFF );
-                _code[pc+2] = ( (l1 >> 8) & 0xFF );
-                _code[pc+3] = ( l1 & 0xFF );
-                pc += OP_LABEL_SIZE;
+            case OP_DATA:
+                i.x = fetch_register();
+                i.d = _machine->get_data_slot(fetch_i32());
+                break;
+            case OP_SET:
+            case OP_SPLIT:
+            case OP_ARRAY:
+            case OP_TAIL:
+            case OP_LT:
+            case OP_LE:
+            case OP_EQ:
+            case OP_NE:
+                i.x = fetch_register();
+                i.y = fetch_register();
+                i.z = fetch_register();
+                break;
+            case OP_TAKEX:
+            case OP_CONCATX:
+            case OP_REUSE:
+                i.x = fetch_register();
+                i.y = fetch_register();
+                i.z = fetch_register();
+                i.i = fetch_i16();
+                break;
+            case OP_FAIL:
+            case OP_JMP:
+                i.l = fetch_i32();
+                break;
+            case OP_JNA:
+                i.x = fetch_register();
+                i.i = fetch_i16();
+                i.l = fetch_i32();
+                break;
+            case OP_JNE:
+            case OP_JNT:
+                i.x = fetch_register();
+                i.y = fetch_register();
+                i.l = fetch_i32();
+                break;
+            case OP_JNX:
+                i.x = fetch_register();
+                i.y = fetch_register();
+                i.z = fetch_register();
+                i.i = fetch_i16();
+                i.l = fetch_i32();
+                break;
+            case OP_JNS:
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                i.x = fetch_register();
+                i.y = fetch_register();
+                i.z = fetch_register();
+                i.l = fetch_i32();
+                break;
+            case OP_SWITCH: {
+                coder_switch_t sw;
+                i.x = fetch_register();
+                sw.kind = (switch_kind_t) fetch_i16();
+                auto n = fetch_i16();
+                i.l = fetch_i32();
+                for (uint16_t j = 0; j < n; j++) {
+                    uint64_t c = fetch_i32();
+                    c = (c << 32) | fetch_i32();
+                    sw.cases.push_back(std::make_pair((int64_t) c, (label_t) fetch_i32()));
+                }
+                i.i = sws.size();
+                sws.push_back(sw);
                 }
                 break;
-            case OP_RETURN:
-                pc += OP_SIZE + 1*OP_REG_SIZE;
+            default:
+                PANIC("couldn't decode opcode");
+            }
+            ii.push_back(i);
+        }
+        offsets[_code.size()] = ii.size();
+
+        for (auto& i:ii) {
+            switch (i.op) {
+            case OP_FAIL:
+            case OP_JNE:
+            case OP_JNT:
+            case OP_JNX:
+            case OP_JNS:
+            case OP_JMP:
+            case OP_JNA:
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                i.l = offsets[i.l];
+                break;
+            case OP_SWITCH: {
+                i.l = offsets[i.l];
+                auto& sw = sws[i.i];
+                for (auto& c:sw.cases) {
+                    c.second = offsets[c.second];
+                }
+                ss.push_back(SwitchTable(sw.kind, sw.cases, i.l));
+                }
+                break;
+            default:
                 break;
             }
         }
+        return ii;
     }
 
 private:
-    Code        _code;
-    int         _label_counter;
-    int         _register_counter;
-    int         _index_counter;
-    Labels      _labels;
+    VM*         _machine;
+    const Code& _code;
+    reg_t       _registers;
+    uint32_t    _pc;
 };
 
-#define FETCH_i8(c, pc)     c[pc]; pc += 1
-#define FETCH_i16(c, pc)    ( (c[pc] << 8) | c[pc+1] ); pc += 2
-#define FETCH_i32(c, pc)    ( (c[pc] << 24) | (c[pc+1] << 16) | (c[pc+2] << 8) |  c[pc+3] ); pc += 4
+// registers are carved from a per thread stack of blocks, windows are
+// released in LIFO order which also holds for nested reductions
+class RegisterStack {
+public:
+    typedef std::pair<size_t, size_t> mark_t;
+
+    RegisterStack(): _block(0), _top(0) {
+        add_block(BLOCK_SIZE);
+    }
+
+    static RegisterStack& local() {
+        static thread_local RegisterStack stack;
+        return stack;
+    }
+
+    mark_t mark() const {
+        return mark_t(_block, _top);
+    }
+
+    VMObjectPtr* allocate(const size_t n) {
+        if (_top + n > _sizes[_block]) {
+            next_block(n);
+        }
+        auto p = _blocks[_block].get() + _top;
+        _top += n;
+        return p;
+    }
+
+    void release(const mark_t& m) {
+        _block = m.first;
+        _top   = m.second;
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    void add_block(const size_t n) {
+        _blocks.push_back(std::unique_ptr<VMObjectPtr[]>(new VMObjectPtr[n]));
+        _sizes.push_back(n);
+    }
+
+    void next_block(const size_t n) {
+        do {
+            _block++;
+            if (_block == _blocks.size()) {
+                add_block(std::max(n, BLOCK_SIZE));
+            }
+        } while (_sizes[_block] < n);
+        _top = 0;
+    }
 
-#define LOOK_op(c, pc)      c[pc++]
-#define FETCH_op(c, pc)     FETCH_i8(c, pc)
-#define FETCH_reg(c,pc)     FETCH_i16(c, pc)
-#define FETCH_idx(c,pc)     FETCH_i16(c, pc)
-#define FETCH_lbl(c,pc)   FETCH_i32(c, pc)
+    std::vector<std::unique_ptr<VMObjectPtr[]>> _blocks;
+    std::vector<size_t>                         _sizes;
+    size_t                                      _block;
+    size_t                                      _top;
+};
 
+// a register window of exactly the size a combinator needs
 class Registers {
 public:
-    Registers() {
-        //_fast.reserve(MAX_REGISTERS);
+    Registers(const reg_t n)
+        : _stack(RegisterStack::local()), _mark(_stack.mark()), _size(n) {
+        _registers = _stack.allocate(n);
     }
 
-    VMObjectPtr get(const reg_t n) {
-        if (n < MAX_REGISTERS) {
-            return _fast[n];
-        } else {
-            return _fallback[n];
+    ~Registers() {
+        for (reg_t n = 0; n < _size; n++) {
+            _registers[n] = nullptr;
         }
+        _stack.release(_mark);
     }
 
-    void set(const reg_t n, VMObjectPtr o) {
-        if (n < MAX_REGISTERS) {
-            _fast[n] = o;
-        } else {
-            _fallback[n] = o;
-        }
+    Registers(const Registers&) = delete;
+    Registers& operator=(const Registers&) = delete;
+
+    reg_t size() const {
+        return _size;
     }
 
-    VMObjectPtr operator[](const reg_t n) {
-        return get(n);
+    const VMObjectPtr& get(const reg_t n) const {
+        return _registers[n];
     }
 
-private:
-    static const int MAX_REGISTERS = 64;
+    void set(const reg_t n, const VMObjectPtr& o) {
+        _registers[n] = o;
+    }
+
+    const VMObjectPtr& operator[](const reg_t n) const {
+        return _registers[n];
+    }
 
-    //std::vector<VMObjectPtr>        _fast;
-    VMObjectPtr                     _fast[MAX_REGISTERS];
-    std::map<reg_t, VMObjectPtr>    _fallback;
+private:
+    RegisterStack&          _stack;
+    RegisterStack::mark_t   _mark;
+    reg_t                   _size;
+    VMObjectPtr*            _registers;
 };
 
 
 class VMObjectBytecode: public VMObjectCombinator {
 public:
 
-    VMObjectBytecode(VM* m, const Code& c, const symbol_t s)
-        : VMObjectCombinator(VM_OBJECT_FLAG_COMBINATOR, m, s), _code(c) {
+    VMObjectBytecode(VM* m, const Code& c, const reg_t r, const int a, const symbol_t s)
+        : VMObjectCombinator(VM_OBJECT_FLAG_COMBINATOR, m, s), _code(c), _registers(r), _arity(a), _instructions(Decoder(m, c, r).decode(_switches)),
+          _false(create_false()), _true(create_true()) {
     };
     
-    VMObjectBytecode(VM* m, const Code& c, const icu::UnicodeString& n)
-        : VMObjectCombinator(VM_OBJECT_FLAG_COMBINATOR, m, n), _code(c) {
+    VMObjectBytecode(VM* m, const Code& c, const reg_t r, const int a, const icu::UnicodeString& n)
+        : VMObjectCombinator(VM_OBJECT_FLAG_COMBINATOR, m, n), _code(c), _registers(r), _arity(a), _instructions(Decoder(m, c, r).decode(_switches)),
+          _false(create_false()), _true(create_true()) {
     };
     
-    VMObjectBytecode(VM* m, const Code& c, const icu::UnicodeString& n0, const icu::UnicodeString& n1)
-        : VMObjectCombinator(VM_OBJECT_FLAG_COMBINATOR, m, n0, n1), _code(c) {
+    VMObjectBytecode(VM* m, const Code& c, const reg_t r, const int a, const icu::UnicodeString& n0, const icu::UnicodeString& n1)
+        : VMObjectCombinator(VM_OBJECT_FLAG_COMBINATOR, m, n0, n1), _code(c), _registers(r), _arity(a), _instructions(Decoder(m, c, r).decode(_switches)),
+          _false(create_false()), _true(create_true()) {
     };
     
-    VMObjectBytecode(VM* m, const Code& c, const UnicodeStrings& nn, const icu::UnicodeString& n)
-        : VMObjectCombinator(VM_OBJECT_FLAG_COMBINATOR, m, nn, n), _code(c) {
+    VMObjectBytecode(VM* m, const Code& c, const reg_t r, const int a, const UnicodeStrings& nn, const icu::UnicodeString& n)
+        : VMObjectCombinator(VM_OBJECT_FLAG_COMBINATOR, m, nn, n), _code(c), _registers(r), _arity(a), _instructions(Decoder(m, c, r).decode(_switches)),
+          _false(create_false()), _true(create_true()) {
     };
     
     VMObjectBytecode(const VMObjectBytecode& d)
-        : VMObjectBytecode(d.machine(), d.code(), d.symbol()) {
+        : VMObjectBytecode(d.machine(), d.code(), d.registers(), d.arity(), d.symbol()) {
     }
     
     VMObjectPtr clone() const override {
@@ -567,14 +2487,79 @@ public:
         return _code;
     }
 
+    reg_t registers() const {
+        return _registers;
+    }
+
+    // the least number of arguments an alternative matches
+    int arity() const override {
+        return _arity;
+    }
+
+    // the decoded instructions are run with threaded dispatch where the
+    // compiler supports computed goto, and with a switch otherwise
+#if defined(__GNUC__) && !defined(BYTECODE_SWITCH) && !defined(DEBUG)
+#define BYTECODE_THREADED
+#endif
+
+#ifdef BYTECODE_THREADED
+#define BYTECODE_DISPATCH   goto *table[ip->op];
+#define BYTECODE_CASE(o)    LABEL_##o:
+#define BYTECODE_JUMP       goto *table[ip->op]
+#else
+#define BYTECODE_DISPATCH   if (vm_statistics) VMStatistics::instruction(ip->op); switch (ip->op)
+#define BYTECODE_CASE(o)    case o:
+#define BYTECODE_JUMP       continue
+#endif
+#define BYTECODE_NEXT       ip++; BYTECODE_JUMP
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        Registers  reg;
+        // no alternative matches fewer arguments, the partial application
+        // is the result
+        VMFrame tt(thunk);
+        if ((int) tt.size() < 5 + _arity) {
+            tt.result(tt.slice(4));
+            return tt.k();
+        }
+
+        Registers  reg(_registers);
 
-        uint32_t pc = 0;
         reg.set(0, thunk);
-        bool flag = false;
+        bool flag  = false;
+        bool owned = false; // whether the frame is a copy only we hold
+
+        const instruction_t* base = _instructions.data();
+        const instruction_t* ip   = base;
+
+#ifdef BYTECODE_THREADED
+        static const void* dispatch_table[] = {
+            &&LABEL_OP_NIL, &&LABEL_OP_MOV, &&LABEL_OP_DATA, &&LABEL_OP_SET,
+            &&LABEL_OP_TAKEX, &&LABEL_OP_SPLIT, &&LABEL_OP_ARRAY, &&LABEL_OP_CONCATX,
+            &&LABEL_OP_TEST, &&LABEL_OP_TAG, &&LABEL_OP_FAIL, &&LABEL_OP_JNE,
+            &&LABEL_OP_JNT, &&LABEL_OP_JNX, &&LABEL_OP_JNS, &&LABEL_OP_SWITCH,
+            &&LABEL_OP_TAIL, &&LABEL_OP_REUSE, &&LABEL_OP_JMP, &&LABEL_OP_JNA,
+            &&LABEL_OP_ADD, &&LABEL_OP_SUB, &&LABEL_OP_MUL, &&LABEL_OP_DIV,
+            &&LABEL_OP_MOD, &&LABEL_OP_LT, &&LABEL_OP_LE, &&LABEL_OP_EQ,
+            &&LABEL_OP_NE, &&LABEL_OP_RETURN,
+        };
+        // when statistics are kept every instruction is counted first
+        static const void* count_table[] = {
+            &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT,
+            &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT,
+            &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT,
+            &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT,
+            &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT,
+            &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT,
+            &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT, &&LABEL_COUNT,
+            &&LABEL_COUNT, &&LABEL_COUNT,
+        };
+        static_assert(sizeof(dispatch_table) == sizeof(count_table), "opcode missing");
+        static_assert(sizeof(count_table) / sizeof(void*) == OP_RETURN + 1, "opcode missing");
+        const void* const* table = (vm_statistics ? count_table : dispatch_table);
+#endif
 
-        EqualVMObjectPtr equals;
         while (true) {
 
 #ifdef DEBUG
@@ -582,49 +2567,42 @@ public:
             std::cout << "eval: ";
             render(std::cout);
             std::cout << std::endl;
-            for (reg_t n = 0; n < 128; n++) {
+            for (reg_t n = 0; n < reg.size(); n++) {
                 if (reg[n] != nullptr) {
                     std::cout << n << "\t" << reg[n] << std::endl;
                 }
             }
 #endif
 
-            switch (LOOK_op(_code, pc)) {
-            case OP_NIL: {
+            BYTECODE_DISPATCH {
+#ifdef BYTECODE_THREADED
+            LABEL_COUNT:
+                VMStatistics::instruction(ip->op);
+                goto *dispatch_table[ip->op];
+#endif
+            BYTECODE_CASE(OP_NIL) {
                 //  x           x := null
-                reg_t       x = FETCH_reg(_code,pc);
-
-                reg.set(x, nullptr);
+                reg.set(ip->x, nullptr);
 
                 }
-                break;
-            case OP_MOV: {
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_MOV) {
                 //  x y         x := y
-                reg_t       x = FETCH_reg(_code,pc);
-                reg_t       y = FETCH_reg(_code,pc);
-
-                reg.set(x, reg[y]);
+                reg.set(ip->x, reg[ip->y]);
 
                 }
-                break;
-            case OP_DATA: {
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_DATA) {
                 //  x i32       x := data(i32)
-                reg_t       x = FETCH_reg(_code,pc);
-                int32_t     i32 = FETCH_i32(_code,pc);
-
-                reg.set(x, machine()->get_data(i32));
+                reg.set(ip->x, *ip->d);
 
                 }
-                break;
-            case OP_SET: {
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_SET) {
                 //  x y z       x[val(y)] := z
-                reg_t       x = FETCH_reg(_code,pc);
-                reg_t       y = FETCH_reg(_code,pc);
-                reg_t       z = FETCH_reg(_code,pc);
-
-                auto x0 = reg[x];
-                auto y0 = reg[y];
-                auto z0 = reg[z];
+                auto x0 = reg[ip->x];
+                auto y0 = reg[ip->y];
+                auto z0 = reg[ip->z];
 
                 ASSERT(x0->tag() == VM_OBJECT_ARRAY);
                 ASSERT(y0->tag() == VM_OBJECT_INTEGER);
@@ -635,93 +2613,67 @@ public:
                 xv->set(yv, z0);
 
                 }
-                break;
-            case OP_TAKEX: {
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_TAKEX) {
                 //  x y z i     x,..,y = z[i],..,z[i+y-x], flag fail
-                reg_t       x = FETCH_reg(_code,pc);
-                reg_t       y = FETCH_reg(_code,pc);
-                reg_t       z = FETCH_reg(_code,pc);
-                index_t     i = FETCH_idx(_code,pc);
-
-                auto z0 = reg[z];
-                if (z0->tag() == VM_OBJECT_ARRAY) {
-                    auto zz = VM_OBJECT_ARRAY_CAST(z0);
-                    flag = (( (int) y - (int) x + 1) <= (int) zz->size() - (int) i);
-                    if (flag) {
-                        for (reg_t n = x; n <= y; n++) {
-                            reg.set(n, zz->get(n-x+i));
-                        }
-                    } else {
-                        // XXX: insert prefetch code here once
-                    }
-                } else {
-                    flag = false;
-                }
+                flag = take(reg, ip->x, ip->y, reg[ip->z], ip->i);
 
                 }
-                break;
-            case OP_SPLIT: {
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_SPLIT) {
                 //  x y z       x,..,y = z[0],..,z[y-x], flag not exact
-                reg_t       x = FETCH_reg(_code,pc);
-                reg_t       y = FETCH_reg(_code,pc);
-                reg_t       z = FETCH_reg(_code,pc);
-
-                auto z0 = reg[z];
-                if (z0->tag() == VM_OBJECT_ARRAY) {
-                    auto zz = VM_OBJECT_ARRAY_CAST(z0);
-                    flag = (( (int) y - (int) x + 1) == (int) zz->size() );
-                    if (flag) {
-                        for (reg_t n = x; n <= y; n++) {
-                            reg.set(n, zz->get(n-x));
-                        }
-                    } else {
-                        // XXX: insert prefetch code here once
-                    }
-                } else {
-                    flag = false;
-                }
+                flag = split(reg, ip->x, ip->y, reg[ip->z]);
 
                 }
-                break;
-            case OP_ARRAY: {
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_ARRAY) {
                 //  x y z       x := [ y, y+1,.., z ]
-                reg_t       x = FETCH_reg(_code,pc);
-                reg_t       y = FETCH_reg(_code,pc);
-                reg_t       z = FETCH_reg(_code,pc);
+                reg_t       y = ip->y;
+                reg_t       z = ip->z;
 
-                auto xx0 = VMObjectArray::create();
-                auto xx1 = VM_OBJECT_ARRAY_CAST(xx0);
+                auto xx = VMObjectArray::allocate(z - y + 1);
                 for (reg_t n = y; n <= z; n++) {
-                    xx1->push_back(reg[n]);
+                    xx->set(n - y, reg[n]);
                 }
-                reg.set(x, xx1);
+                reg.set(ip->x, VMObjectPtr(xx));
 
                 }
-                break;
-            case OP_CONCATX: {
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_CONCATX) {
                 //  x y z i     x := y ++ drop i z
-                reg_t       x = FETCH_reg(_code,pc);
-                reg_t       y = FETCH_reg(_code,pc);
-                reg_t       z = FETCH_reg(_code,pc);
-                index_t     i = FETCH_idx(_code,pc);
+                index_t     i = ip->i;
 
-                auto y0 = reg[y];
-                auto z0 = reg[z];
+                auto& y0 = reg[ip->y];
+                auto& z0 = reg[ip->z];
                 if ((y0->tag() == VM_OBJECT_ARRAY) &&
                     (z0->tag() == VM_OBJECT_ARRAY) ) {
-                    auto yy = VM_OBJECT_ARRAY_VALUE(y0);
-                    auto zz = VM_OBJECT_ARRAY_VALUE(z0);
-
-                    auto xx0 = VMObjectArray::create();
-                    auto xx1 = VM_OBJECT_ARRAY_CAST(xx0);
-
-                    for (auto& y1:yy) xx1->push_back(y1);
-                    for (int n = (int) i; n < (int) zz.size(); n++) xx1->push_back(zz[n]);
-
-                    if (xx1->size() == 1) { // XXX: move to reg.set?
-                        reg.set(x, xx1->get(0));
+                    auto& yy = *static_cast<const VMObjectArray*>(y0.get());
+                    auto& zz = *static_cast<const VMObjectArray*>(z0.get());
+
+                    // the emitted code never reads y after a concatx, a 
+                    // y only its register refers to is passed on as is when
+                    // nothing is dropped from z
+                    // (no dispatch from inside this block, a computed goto skips
+                    // the destructors of its locals)
+                    if (y0.unique() && yy.size() > 1 && (int) i >= zz.size()) {
+                        if (ip->x != ip->y) {
+                            reg.set(ip->x, y0);
+                            reg.set(ip->y, nullptr);
+                        }
                     } else {
-                        reg.set(x, xx1);
+                        uint sz = yy.size() + ((int) i < zz.size() ? zz.size() - (int) i : 0);
+                        auto xx = VMObjectArray::allocate(sz);
+                        VMObjectPtr xx0(xx);
+
+                        uint j = 0;
+                        for (auto& y1:yy) xx->set(j++, y1);
+                        for (int n = (int) i; n < zz.size(); n++) xx->set(j++, zz[n]);
+
+                        if (sz == 1) { // XXX: move to reg.set?
+                            reg.set(ip->x, xx->get(0));
+                        } else {
+                            reg.set(ip->x, xx0);
+                        }
                     }
                 } else {
                     PANIC("two arrays expected");
@@ -729,54 +2681,287 @@ public:
                 }
 
                 }
-                break;
-            case OP_TEST: {
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_TEST) {
                 //  x y         flag := (x == y)
-                reg_t       x = FETCH_reg(_code,pc);
-                reg_t       y = FETCH_reg(_code,pc);
-
-                auto x0 = reg[x];
-                auto y0 = reg[y];
-                flag = equals(x0, y0);
+                flag = test(reg[ip->x], reg[ip->y]);
 
                 }
-                break;
-            case OP_TAG: {
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_TAG) {
                 //  x y         flag := (x, or x[0], == y)
-                reg_t       x = FETCH_reg(_code,pc);
-                reg_t       y = FETCH_reg(_code,pc);
+                flag = tag(reg[ip->x], reg[ip->y]);
 
-                auto x0 = reg[x];
-                auto y0 = reg[y];
+                }
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_FAIL) {
+                //  l           pc := l, if ~flag
+                ip = (flag ? ip + 1 : base + ip->l);
+                flag = false;
 
-                auto s0 = x0->symbol();
-                auto s1 = y0->symbol();
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_JNE) {
+                //  x y l       pc := l, if x != y
+                ip = (test(reg[ip->x], reg[ip->y]) ? ip + 1 : base + ip->l);
 
-                flag = (s0 == s1);
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_JNT) {
+                //  x y l       pc := l, if (x, or x[0], != y)
+                ip = (tag(reg[ip->x], reg[ip->y]) ? ip + 1 : base + ip->l);
 
                 }
-                break;
-            case OP_FAIL: {
-                //  l           pc := l, if ~flag
-                label_t     l = FETCH_lbl(_code,pc);
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_JNX) {
+                //  x y z i l   x,..,y = z[i],..,z[i+y-x], or pc := l
+                ip = (take(reg, ip->x, ip->y, reg[ip->z], ip->i) ? ip + 1 : base + ip->l);
+
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_JNS) {
+                //  x y z l     x,..,y = z[0],..,z[y-x], or pc := l
+                ip = (split(reg, ip->x, ip->y, reg[ip->z]) ? ip + 1 : base + ip->l);
+
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_SWITCH) {
+                //  x k n l ..  pc := l_i if key_k(x) == c_i, else l
+                ip = base + _switches[ip->i].lookup(reg[ip->x]);
 
-                if (!flag) pc = l;
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_TAIL) {
+                //  x y z       x[5],..,x[5+z-y] := y,..,z, restart on frame x
+                if (!owned) {
+                    auto& xx = *static_cast<const VMObjectArray*>(reg[ip->x].get());
+                    reg.set(0, VMObjectArray::create(xx, 0, xx.size()));
+                    owned = true;
+                } else if (ip->x != 0) {
+                    reg.set(0, reg[ip->x]);
+                }
+                auto ff = VM_OBJECT_ARRAY_CAST(reg[0]);
+                for (reg_t n = ip->y; n <= ip->z; n++) {
+                    ff->set(5 + n - ip->y, reg[n]);
+                }
                 flag = false;
+                ip = base;
 
                 }
-                break;
-            case OP_RETURN: {
-                //  x           return x
-                reg_t       x = FETCH_reg(_code,pc);
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_REUSE) {
+                //  x y z i     x := empty array the size of y, y taken from frame z[i] if only it refers to y
+                auto& y0 = reg[ip->y];
+                auto& z0 = reg[ip->z];
+                auto  sz = VM_OBJECT_ARRAY_REF(y0).size();
+
+                // the frame is held by the trampoline and register 0, or 
+                // by register 0 alone once it is a copy of our own, and
+                // isn't read below its extra arguments anymore
+                uint32_t held = (owned ? 1 : 2) + (ip->z != 0 ? 1 : 0);
+                if (z0 == reg[0] && z0.count() == held && y0.count() == 2 &&
+                    VM_OBJECT_ARRAY_REF(z0)[ip->i] == y0) {
+                    auto zz = VM_OBJECT_ARRAY_CAST(z0);
+                    zz->set(ip->i, nullptr);
+                    auto yy = VM_OBJECT_ARRAY_CAST(y0);
+                    for (int n = 0; n < sz; n++) yy->set(n, nullptr);
+                    if (ip->x != ip->y) {
+                        reg.set(ip->x, y0);
+                        reg.set(ip->y, nullptr);
+                    }
+                } else {
+                    reg.set(ip->x, VMObjectPtr(VMObjectArray::allocate(sz)));
+                }
 
-                return reg[x];
                 }
-                break;
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_JMP) {
+                //  l           pc := l
+                ip = base + ip->l;
+
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_JNA) {
+                //  x i l       pc := l, if x isn't an array of i elements
+                auto& x0 = reg[ip->x];
+                ip = ((x0->tag() == VM_OBJECT_ARRAY && VM_OBJECT_ARRAY_REF(x0).size() == (int) ip->i) ?
+                      ip + 1 : base + ip->l);
+
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_ADD) {
+                //  x y z l     x := y + z, or pc := l
+                ip = (arithmetic(reg, ip->x, reg[ip->y], reg[ip->z],
+                        [](vm_int_t a, vm_int_t b, vm_int_t& c) { return !__builtin_saddl_overflow(a, b, &c); },
+                        [](vm_float_t a, vm_float_t b, vm_float_t& c) { c = a + b; return true; }) ?
+                      ip + 1 : base + ip->l);
+
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_SUB) {
+                //  x y z l     x := y - z, or pc := l
+                ip = (arithmetic(reg, ip->x, reg[ip->y], reg[ip->z],
+                        [](vm_int_t a, vm_int_t b, vm_int_t& c) { return !__builtin_ssubl_overflow(a, b, &c); },
+                        [](vm_float_t a, vm_float_t b, vm_float_t& c) { c = a - b; return true; }) ?
+                      ip + 1 : base + ip->l);
+
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_MUL) {
+                //  x y z l     x := y * z, or pc := l
+                ip = (arithmetic(reg, ip->x, reg[ip->y], reg[ip->z],
+                        [](vm_int_t a, vm_int_t b, vm_int_t& c) { return !__builtin_smull_overflow(a, b, &c); },
+                        [](vm_float_t a, vm_float_t b, vm_float_t& c) { c = a * b; return true; }) ?
+                      ip + 1 : base + ip->l);
+
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_DIV) {
+                //  x y z l     x := y / z, or pc := l
+                ip = (arithmetic(reg, ip->x, reg[ip->y], reg[ip->z],
+                        [](vm_int_t a, vm_int_t b, vm_int_t& c) { if (b == 0) return false; c = a / b; return true; },
+                        [](vm_float_t a, vm_float_t b, vm_float_t& c) { if (b == 0.0) return false; c = a / b; return true; }) ?
+                      ip + 1 : base + ip->l);
+
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_MOD) {
+                //  x y z l     x := y % z, or pc := l
+                ip = (arithmetic(reg, ip->x, reg[ip->y], reg[ip->z],
+                        [](vm_int_t a, vm_int_t b, vm_int_t& c) { if (b == 0) return false; c = a % b; return true; },
+                        [](vm_float_t a, vm_float_t b, vm_float_t& c) { return false; }) ?
+                      ip + 1 : base + ip->l);
+
+                }
+                BYTECODE_JUMP;
+            BYTECODE_CASE(OP_LT) {
+                //  x y z       x := (y < z)
+                reg.set(ip->x, (compare(reg[ip->y], reg[ip->z]) < 0) ? _true : _false);
+
+                }
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_LE) {
+                //  x y z       x := (y <= z)
+                reg.set(ip->x, (compare(reg[ip->y], reg[ip->z]) <= 0) ? _true : _false);
+
+                }
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_EQ) {
+                //  x y z       x := (y == z)
+                reg.set(ip->x, (compare(reg[ip->y], reg[ip->z]) == 0) ? _true : _false);
+
+                }
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_NE) {
+                //  x y z       x := (y != z)
+                reg.set(ip->x, (compare(reg[ip->y], reg[ip->z]) != 0) ? _true : _false);
+
+                }
+                BYTECODE_NEXT;
+            BYTECODE_CASE(OP_RETURN) {
+                //  x           return x
+                return reg[ip->x];
+                }
             }
         }
     }
+#pragma GCC diagnostic pop
+
+#undef BYTECODE_THREADED
+#undef BYTECODE_DISPATCH
+#undef BYTECODE_CASE
+#undef BYTECODE_JUMP
+#undef BYTECODE_NEXT
+
 private:
-    Code  _code;
+    static bool take(Registers& reg, const reg_t x, const reg_t y, const VMObjectPtr& z0, const index_t i) {
+        if (z0->tag() == VM_OBJECT_ARRAY) {
+            auto zz = VM_OBJECT_ARRAY_CAST(z0);
+            if (( (int) y - (int) x + 1) <= (int) zz->size() - (int) i) {
+                for (reg_t n = x; n <= y; n++) {
+                    reg.set(n, (*zz)[n-x+i]);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool split(Registers& reg, const reg_t x, const reg_t y, const VMObjectPtr& z0) {
+        if (z0->tag() == VM_OBJECT_ARRAY) {
+            auto zz = VM_OBJECT_ARRAY_CAST(z0);
+            if (( (int) y - (int) x + 1) == (int) zz->size() ) {
+                for (reg_t n = x; n <= y; n++) {
+                    reg.set(n, (*zz)[n-x]);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool test(const VMObjectPtr& x0, const VMObjectPtr& y0) {
+        // immediates and pinned constants compare on their bits
+        if (x0 == y0) {
+            return true;
+        } else if (x0.is_immediate() && y0.is_immediate()) {
+            return false;
+        } else {
+            EqualVMObjectPtr equals;
+            return equals(x0, y0);
+        }
+    }
+
+    // integer arithmetic on immediates and float arithmetic, anything
+    // else, like overflow or a division by zero, is left to the builtin
+    template <typename I, typename F>
+    static bool arithmetic(Registers& reg, const reg_t x, const VMObjectPtr& y0, const VMObjectPtr& z0, I i, F f) {
+        if (y0.is_integer() && z0.is_integer()) {
+            vm_int_t n;
+            if (!i(y0.integer(), z0.integer(), n)) return false;
+            reg.set(x, VMObjectInteger::create(n));
+            return true;
+        } else if (y0->tag() == VM_OBJECT_FLOAT && z0->tag() == VM_OBJECT_FLOAT) {
+            vm_float_t d;
+            if (!f(VM_OBJECT_FLOAT_VALUE(y0), VM_OBJECT_FLOAT_VALUE(z0), d)) return false;
+            reg.set(x, VMObjectFloat::create(d));
+            return true;
+        }
+        return false;
+    }
+
+    // the order of the comparison builtins
+    static int compare(const VMObjectPtr& y0, const VMObjectPtr& z0) {
+        CompareVMObjectPtr compare;
+        return compare(y0, z0);
+    }
+
+    static bool tag(const VMObjectPtr& x0, const VMObjectPtr& y0) {
+        if (x0 == y0) {
+            return true;
+        } else {
+            symbol_t s0;
+            if (x0.is_integer()) {
+                s0 = SYMBOL_INT;
+            } else if (x0.is_char()) {
+                s0 = SYMBOL_CHAR;
+            } else {
+                s0 = x0->symbol();
+            }
+            return (s0 == y0->symbol());
+        }
+    }
+
+    Code            _code;
+    reg_t           _registers;
+    int             _arity;
+    SwitchTables    _switches;
+    Instructions    _instructions;
+    VMObjectPtr     _false;
+    VMObjectPtr     _true;
 };
 
+#define VM_OBJECT_BYTECODE_CAST(a) \
+    vm_object_cast<VMObjectBytecode>(a)
+
 #endif
@@ -0,0 +1,709 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include "position.hpp"
+#include "semantical.hpp"
+#include "emit.hpp"
+#include "bytecode.hpp"
+
+/**
+ * Compiled source modules are cached next to their source, 'prelude.eg'
+ * in 'prelude.egc'. A cache holds what the compiler would otherwise
+ * recompute: the imports, the declarations, and the data and bytecode
+ * defined. Code refers to file local data and symbol tables which are
+ * relocated into the machine on loading.
+ *
+ * A cache is fresh when it was written for the same format of the code,
+ * and the source and all the modules it imports, directly or
+ * indirectly, hash to what they hashed to when it was written. A file
+ * ends with a checksum of its contents, a damaged cache is stale too.
+ *
+ * Names resolve against everything loaded with a module, not only its
+ * imports. Code refers to what other modules define by name, and is
+ * emitted for what those names were: data, a builtin of some arity, or
+ * bytecode. A cache is only used when all those names are declared
+ * again as the same. What a module compiled from source defines isn't
+ * known in advance, caches referring to it are compiled again too.
+ *
+ * Bump the version whenever the code generator emits different code
+ * for the same opcodes, changes to the opcodes are noticed.
+ **/
+
+#define CACHE_MAGIC     "egelcache"
+#define CACHE_VERSION   6
+#define CACHE_EXTENSION "c"
+
+// the kinds of data table entries a cache can hold
+typedef enum {
+    CACHE_INTEGER,
+    CACHE_FLOAT,
+    CACHE_CHAR,
+    CACHE_TEXT,
+    CACHE_COMBINATOR,
+} cache_entry_kind_t;
+
+typedef struct {
+    cache_entry_kind_t  kind;
+    int64_t             value;
+    icu::UnicodeString  text;
+} cache_entry_t;
+
+// a definition is a data constructor or bytecode
+typedef struct {
+    bool                bytecode;
+    icu::UnicodeString  name;
+    reg_t               registers;
+    int32_t             arity;
+    Code                code;
+} cache_definition_t;
+
+typedef struct {
+    icu::UnicodeString  path;
+    uint64_t            hash;
+} cache_dependency_t;
+
+typedef struct {
+    int32_t             row;
+    int32_t             column;
+    icu::UnicodeString  filename;
+} cache_import_t;
+
+// what a name defined elsewhere is, unknown until it is defined
+typedef enum {
+    CACHE_UNKNOWN,
+    CACHE_DATA,
+    CACHE_BUILTIN,
+    CACHE_BYTECODE,
+} cache_reference_kind_t;
+
+typedef struct {
+    icu::UnicodeString      name;
+    cache_reference_kind_t  kind;
+    int32_t                 arity;      // of a builtin
+} cache_reference_t;
+
+typedef std::vector<cache_entry_t>      CacheEntries;
+typedef std::vector<cache_definition_t> CacheDefinitions;
+typedef std::vector<cache_dependency_t> CacheDependencies;
+typedef std::vector<cache_import_t>     CacheImports;
+typedef std::vector<cache_reference_t>  CacheReferences;
+
+#define CACHE_FNV_BASIS 14695981039346656037ULL
+
+// FNV-1a, continued from h
+inline uint64_t cache_fnv(const char* bytes, const size_t n, uint64_t h = CACHE_FNV_BASIS) {
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ (uint8_t) bytes[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+// FNV-1a of the bytes of a file, zero if it can't be read
+inline uint64_t cache_hash(const icu::UnicodeString& path) {
+    std::string fn;
+    path.toUTF8String(fn);
+    std::ifstream f(fn, std::ios::binary);
+    if (!f) return 0;
+    uint64_t h = CACHE_FNV_BASIS;
+    char buf[8192];
+    while (f.read(buf, sizeof(buf)) || f.gcount() > 0) {
+        h = cache_fnv(buf, f.gcount(), h);
+    }
+    return h;
+}
+
+// the opcodes, their operands, and the sizes of literals
+inline uint64_t cache_stamp() {
+    std::string s;
+    for (int n = 0; n <= OP_RETURN; n++) {
+        s += Disassembler::opcode_to_text((opcode_t) n);
+        s += " ";
+    }
+    s += std::to_string(OP_REG_SIZE) + " " + std::to_string(OP_INT_SIZE) + " " +
+         std::to_string(OP_LABEL_SIZE) + " " + std::to_string(OP_INDEX_SIZE) + " " +
+         std::to_string(sizeof(vm_int_t)) + " " + std::to_string(sizeof(vm_float_t));
+    return cache_fnv(s.data(), s.size());
+}
+
+// what the object a name is defined as is
+inline cache_reference_t cache_reference(const icu::UnicodeString& n, const VMObjectPtr& o) {
+    cache_reference_t r = { n, CACHE_UNKNOWN, 0 };
+    if (o->tag() != VM_OBJECT_COMBINATOR) return r;
+    switch (o->flag()) {
+    case VM_OBJECT_FLAG_DATA:
+        r.kind = CACHE_DATA;
+        break;
+    case VM_OBJECT_FLAG_INTERNAL:
+        r.kind = CACHE_BUILTIN;
+        r.arity = VM_OBJECT_COMBINATOR_CAST(o)->arity();
+        break;
+    case VM_OBJECT_FLAG_COMBINATOR:
+        r.kind = CACHE_BYTECODE;
+        break;
+    default:
+        break;
+    }
+    return r;
+}
+
+// whether a name is known to be what it was
+inline bool cache_reference_same(const cache_reference_t& r0, const cache_reference_t& r1) {
+    return r0.kind != CACHE_UNKNOWN && r0.kind == r1.kind && r0.arity == r1.arity;
+}
+
+inline icu::UnicodeString cache_path(const icu::UnicodeString& path) {
+    return path + CACHE_EXTENSION;
+}
+
+class CacheWriter {
+public:
+    void u8(const uint8_t n) {
+        _bytes.push_back((char) n);
+    }
+
+    void i32(const uint32_t n) {
+        u8(n >> 24); u8(n >> 16); u8(n >> 8); u8(n);
+    }
+
+    void i64(const uint64_t n) {
+        i32(n >> 32); i32(n);
+    }
+
+    void bytes(const std::string& s) {
+        i32(s.size());
+        _bytes += s;
+    }
+
+    void text(const icu::UnicodeString& s) {
+        std::string t;
+        s.toUTF8String(t);
+        bytes(t);
+    }
+
+    // written aside and renamed such that readers never see half a file,
+    // the checksum of the contents goes last
+    bool save(const icu::UnicodeString& path) const {
+        std::string fn;
+        path.toUTF8String(fn);
+        auto tmp = fn + "." + std::to_string(getpid());
+        {
+            std::ofstream f(tmp, std::ios::binary);
+            if (!f) return false;
+            auto h = cache_fnv(_bytes.data(), _bytes.size());
+            char sum[8];
+            for (int n = 0; n < 8; n++) sum[n] = (char) (h >> (56 - 8 * n));
+            f.write(_bytes.data(), _bytes.size());
+            f.write(sum, sizeof(sum));
+            if (!f) {
+                remove(tmp.c_str());
+                return false;
+            }
+        }
+        if (rename(tmp.c_str(), fn.c_str()) != 0) {
+            remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string _bytes;
+};
+
+// files are mapped and checked, reading past the end sets a flag and 
+// yields zeroes
+class CacheReader {
+public:
+    CacheReader() {
+    }
+
+    CacheReader(const CacheReader&) = delete;
+    CacheReader& operator=(const CacheReader&) = delete;
+
+    ~CacheReader() {
+        if (_bytes != nullptr) munmap((void*) _bytes, _mapped);
+    }
+
+    bool load(const icu::UnicodeString& path) {
+        std::string fn;
+        path.toUTF8String(fn);
+        int fd = open(fn.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        _bytes = (const char*) p;
+        _mapped = st.st_size;
+        if (_mapped < 8) return false;
+        // the contents without the checksum
+        _size = _mapped - 8;
+        _pos = 0;
+        uint64_t h = 0;
+        for (size_t i = _size; i < _mapped; i++) h = (h << 8) | (uint8_t) _bytes[i];
+        _good = (h == cache_fnv(_bytes, _size));
+        return _good;
+    }
+
+    bool good() const {
+        return _good;
+    }
+
+    bool done() const {
+        return _pos == _size;
+    }
+
+    uint8_t u8() {
+        if (_pos >= _size) {
+            _good = false;
+            return 0;
+        }
+        return (uint8_t) _bytes[_pos++];
+    }
+
+    uint32_t i32() {
+        uint32_t n = u8();
+        n = (n << 8) | u8();
+        n = (n << 8) | u8();
+        return (n << 8) | u8();
+    }
+
+    uint64_t i64() {
+        uint64_t n = i32();
+        return (n << 32) | i32();
+    }
+
+    std::string bytes() {
+        uint32_t n = i32();
+        if (!_good || n > _size - _pos) {
+            _good = false;
+            return "";
+        }
+        auto s = std::string(_bytes + _pos, n);
+        _pos += n;
+        return s;
+    }
+
+    icu::UnicodeString text() {
+        return icu::UnicodeString::fromUTF8(bytes());
+    }
+
+private:
+    const char* _bytes = nullptr;
+    size_t      _mapped = 0;
+    size_t      _size = 0;
+    size_t      _pos = 0;
+    bool        _good = false;
+};
+
+// magic, version, and the format of the code
+inline void cache_write_header(CacheWriter& w, const char* magic) {
+    w.bytes(magic);
+    w.i32(CACHE_VERSION);
+    w.i64(cache_stamp());
+}
+
+inline bool cache_read_header(CacheReader& r, const char* magic) {
+    if (r.bytes() != magic) return false;
+    if (r.i32() != CACHE_VERSION) return false;
+    return r.i64() == cache_stamp();
+}
+
+inline CacheDependencies cache_dependencies(const UnicodeStrings& pp) {
+    CacheDependencies dd;
+    for (auto& p:pp) {
+        dd.push_back(cache_dependency_t{p, cache_hash(p)});
+    }
+    return dd;
+}
+
+inline void cache_write_dependencies(CacheWriter& w, const CacheDependencies& dd) {
+    w.i32(dd.size());
+    for (auto& d:dd) {
+        w.text(d.path);
+        w.i64(d.hash);
+    }
+}
+
+// false if a dependency changed
+inline bool cache_read_dependencies(CacheReader& r, CacheDependencies& dd) {
+    uint32_t n = r.i32();
+    for (uint32_t i = 0; i < n && r.good(); i++) {
+        cache_dependency_t d;
+        d.path = r.text();
+        d.hash = r.i64();
+        if (cache_hash(d.path) != d.hash) return false;
+        dd.push_back(d);
+    }
+    return r.good();
+}
+
+class Cache;
+typedef std::shared_ptr<Cache> CachePtr;
+
+class Cache {
+public:
+    Cache() {
+    }
+
+    CacheDependencies dependencies() const {
+        return _dependencies;
+    }
+
+    CacheImports imports() const {
+        return _imports;
+    }
+
+    Declarations declarations() const {
+        return _declarations;
+    }
+
+    void set_dependencies(const UnicodeStrings& pp) {
+        _dependencies = cache_dependencies(pp);
+    }
+
+    void set_imports(const CacheImports& ii) {
+        _imports = ii;
+    }
+
+    void set_declarations(const Declarations& dd) {
+        _declarations = dd;
+    }
+
+    // capture the definitions, false if an object can't be cached
+    bool set_definitions(VM* m, const VMObjectPtrs& oo) {
+        std::map<data_t, uint32_t> data;
+        std::map<symbol_t, uint32_t> symbols;
+        _entries.clear();
+        _symbols.clear();
+        _definitions.clear();
+
+        bool ok = true;
+        auto local_data = [&](uint32_t d) {
+            if (data.count(d) == 0) {
+                auto o = m->get_data(d);
+                cache_entry_t e = { CACHE_INTEGER, 0, "" };
+                if (o.is_integer()) {
+                    e.value = o.integer();
+                } else if (o.is_char()) {
+                    e.kind = CACHE_CHAR;
+                    e.value = o.character();
+                } else {
+                    switch (o->tag()) {
+                    case VM_OBJECT_INTEGER:
+                        e.value = VM_OBJECT_INTEGER_VALUE(o);
+                        break;
+                    case VM_OBJECT_FLOAT: {
+                        e.kind = CACHE_FLOAT;
+                        auto f = VM_OBJECT_FLOAT_VALUE(o);
+                        memcpy(&e.value, &f, sizeof(e.value));
+                        }
+                        break;
+                    case VM_OBJECT_CHAR:
+                        e.kind = CACHE_CHAR;
+                        e.value = VM_OBJECT_CHAR_VALUE(o);
+                        break;
+                    case VM_OBJECT_TEXT:
+                        e.kind = CACHE_TEXT;
+                        e.text = VM_OBJECT_TEXT_VALUE(o);
+                        break;
+                    case VM_OBJECT_COMBINATOR:
+                        e.kind = CACHE_COMBINATOR;
+                        e.text = m->get_symbol(o->symbol());
+                        break;
+                    default:
+                        ok = false;
+                        break;
+                    }
+                }
+                data[d] = _entries.size();
+                _entries.push_back(e);
+            }
+            return data[d];
+        };
+        auto local_symbol = [&](int64_t s) {
+            if (symbols.count(s) == 0) {
+                symbols[s] = _symbols.size();
+                _symbols.push_back(m->get_symbol(s));
+            }
+            return (int64_t) symbols[s];
+        };
+
+        for (auto& o:oo) {
+            cache_definition_t d = { false, m->get_symbol(o->symbol()), 0, 0, Code() };
+            if (o->flag() == VM_OBJECT_FLAG_COMBINATOR) {
+                auto b = VM_OBJECT_BYTECODE_CAST(o);
+                d.bytecode = true;
+                d.registers = b->registers();
+                d.arity = b->arity();
+                d.code = b->code();
+                ok = Relocator(d.code).relocate(local_data, local_symbol) && ok;
+            }
+            _definitions.push_back(d);
+        }
+
+        _references.clear();
+        for (auto& n:external()) {
+            _references.push_back(cache_reference(n, m->get_data_string(n)));
+        }
+        return ok;
+    }
+
+    bool save(const icu::UnicodeString& path) const {
+        CacheWriter w;
+        cache_write_header(w, CACHE_MAGIC);
+        cache_write_dependencies(w, _dependencies);
+        write(w);
+        return w.save(path);
+    }
+
+    // load a fresh cache, false if there is none
+    bool load(const icu::UnicodeString& path) {
+        CacheReader r;
+        if (!r.load(path)) return false;
+        if (!cache_read_header(r, CACHE_MAGIC)) return false;
+        if (!cache_read_dependencies(r, _dependencies)) return false;
+        return read(r) && r.done();
+    }
+
+    // everything but the header and the dependencies
+    void write(CacheWriter& w) const {
+        w.i32(_imports.size());
+        for (auto& i:_imports) {
+            w.i32(i.row);
+            w.i32(i.column);
+            w.text(i.filename);
+        }
+        w.i32(_declarations.size());
+        for (auto& d:_declarations) {
+            w.i32(d.spaces.size());
+            for (auto& s:d.spaces) {
+                w.text(s);
+            }
+            w.text(d.name);
+            w.text(d.qualified);
+            w.u8(d.implicit);
+            w.i32(d.position.row());
+            w.i32(d.position.column());
+        }
+        w.i32(_symbols.size());
+        for (auto& s:_symbols) {
+            w.text(s);
+        }
+        w.i32(_entries.size());
+        for (auto& e:_entries) {
+            w.u8(e.kind);
+            w.i64(e.value);
+            w.text(e.text);
+        }
+        w.i32(_definitions.size());
+        for (auto& d:_definitions) {
+            w.u8(d.bytecode);
+            w.text(d.name);
+            w.i32(d.registers);
+            w.i32(d.arity);
+            w.bytes(std::string(d.code.begin(), d.code.end()));
+        }
+        w.i32(_references.size());
+        for (auto& r:_references) {
+            w.text(r.name);
+            w.u8(r.kind);
+            w.i32(r.arity);
+        }
+    }
+
+    bool read(CacheReader& r) {
+        uint32_t n = r.i32();
+        for (uint32_t i = 0; i < n && r.good(); i++) {
+            cache_import_t m;
+            m.row = r.i32();
+            m.column = r.i32();
+            m.filename = r.text();
+            _imports.push_back(m);
+        }
+        n = r.i32();
+        for (uint32_t i = 0; i < n && r.good(); i++) {
+            declaration_t d;
+            uint32_t k = r.i32();
+            for (uint32_t j = 0; j < k && r.good(); j++) {
+                d.spaces.push_back(r.text());
+            }
+            d.name = r.text();
+            d.qualified = r.text();
+            d.implicit = r.u8();
+            int32_t row = r.i32();
+            int32_t column = r.i32();
+            d.position = Position("", row, column);
+            _declarations.push_back(d);
+        }
+        n = r.i32();
+        for (uint32_t i = 0; i < n && r.good(); i++) {
+            _symbols.push_back(r.text());
+        }
+        n = r.i32();
+        for (uint32_t i = 0; i < n && r.good(); i++) {
+            cache_entry_t e;
+            e.kind = (cache_entry_kind_t) r.u8();
+            e.value = r.i64();
+            e.text = r.text();
+            if (e.kind > CACHE_COMBINATOR) return false;
+            _entries.push_back(e);
+        }
+        n = r.i32();
+        for (uint32_t i = 0; i < n && r.good(); i++) {
+            cache_definition_t d;
+            d.bytecode = r.u8();
+            d.name = r.text();
+            d.registers = r.i32();
+            d.arity = r.i32();
+            auto c = r.bytes();
+            d.code = Code(c.begin(), c.end());
+            _definitions.push_back(d);
+        }
+        n = r.i32();
+        for (uint32_t i = 0; i < n && r.good(); i++) {
+            cache_reference_t k;
+            k.name = r.text();
+            k.kind = (cache_reference_kind_t) r.u8();
+            k.arity = r.i32();
+            if (k.kind > CACHE_BYTECODE) return false;
+            _references.push_back(k);
+        }
+        return r.good() && valid();
+    }
+
+    // the names the code refers to which it doesn't define itself, and
+    // what they were when it was emitted
+    CacheReferences references() const {
+        return _references;
+    }
+
+    // what the names the module declares are defined as
+    CacheReferences defined() const {
+        std::map<icu::UnicodeString, cache_reference_kind_t> kk;
+        for (auto& d:_definitions) {
+            kk[d.name] = d.bytecode ? CACHE_BYTECODE : CACHE_DATA;
+        }
+        CacheReferences rr;
+        for (auto& d:_declarations) {
+            auto i = kk.find(d.qualified);
+            rr.push_back(cache_reference_t{d.qualified, i == kk.end() ? CACHE_UNKNOWN : i->second, 0});
+        }
+        return rr;
+    }
+
+    // the names the code refers to which it doesn't define itself
+    UnicodeStrings external() const {
+        std::set<icu::UnicodeString> defined;
+        for (auto& d:_definitions) {
+            defined.insert(d.name);
+        }
+        std::set<icu::UnicodeString> ss;
+        for (auto& e:_entries) {
+            if (e.kind == CACHE_COMBINATOR && defined.count(e.text) == 0) ss.insert(e.text);
+        }
+        for (auto& s:_symbols) {
+            if (defined.count(s) == 0) ss.insert(s);
+        }
+        return UnicodeStrings(ss.begin(), ss.end());
+    }
+
+    // whether all code is well formed and refers to data and symbols
+    // which are in the cache
+    bool valid() const {
+        bool ok = true;
+        for (auto& d:_definitions) {
+            if (!d.bytecode) continue;
+            auto c = d.code;
+            ok = Relocator(c).relocate(
+                [&](uint32_t i) { if (i >= _entries.size()) ok = false; return i; },
+                [&](int64_t s) { if (s < 0 || (size_t) s >= _symbols.size()) ok = false; return s; }) && ok;
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+    // define the data constructors
+    void define_data(VM* m) const {
+        for (auto& d:_definitions) {
+            if (!d.bytecode) {
+                m->define_data(VMObjectData(m, d.name).clone());
+            }
+        }
+    }
+
+    // define everything, relocating the code into the machine
+    VMObjectPtrs define_code(VM* m) const {
+        std::vector<data_t> data;
+        for (auto& e:_entries) {
+            VMObjectPtr o;
+            switch (e.kind) {
+            case CACHE_INTEGER:
+                o = VMObjectInteger(e.value).clone();
+                break;
+            case CACHE_FLOAT: {
+                vm_float_t f;
+                memcpy(&f, &e.value, sizeof(f));
+                o = VMObjectFloat(f).clone();
+                }
+                break;
+            case CACHE_CHAR:
+                o = VMObjectChar(e.value).clone();
+                break;
+            case CACHE_TEXT:
+                o = VMObjectText(e.text).clone();
+                break;
+            case CACHE_COMBINATOR:
+                o = m->get_data_string(e.text);
+                break;
+            }
+            data.push_back(m->enter_data(o));
+        }
+        std::vector<symbol_t> symbols;
+        for (auto& s:_symbols) {
+            symbols.push_back(m->enter_symbol(s));
+        }
+
+        VMObjectPtrs oo;
+        for (auto& d:_definitions) {
+            VMObjectPtr o;
+            if (d.bytecode) {
+                auto c = d.code;
+                Relocator(c).relocate(
+                    [&](uint32_t i) { return (uint32_t) data[i]; },
+                    [&](int64_t s) { return (int64_t) symbols[s]; });
+                o = VMObjectBytecode(m, c, d.registers, d.arity, d.name).clone();
+            } else {
+                o = VMObjectData(m, d.name).clone();
+            }
+            m->define_data(o);
+            oo.push_back(o);
+        }
+        return oo;
+    }
+
+private:
+    CacheDependencies   _dependencies;
+    CacheImports        _imports;
+    Declarations        _declarations;
+    UnicodeStrings      _symbols;
+    CacheEntries        _entries;
+    CacheDefinitions    _definitions;
+    CacheReferences     _references;
+};
+
+#endif
@@ -34,17 +34,113 @@ AstPtr pass_wildcard(const AstPtr& a) {
 }
 
 
-class RewriteCondition: public Rewrite {
+// a term which needs no reduction, it can be tested or bound in the 
+// frame of the combinator it occurs in
+static bool evaluated(const AstPtr& a) {
+    switch (a->tag()) {
+    case AST_EXPR_VARIABLE:
+    case AST_EXPR_INTEGER:
+    case AST_EXPR_FLOAT:
+    case AST_EXPR_CHARACTER:
+    case AST_EXPR_TEXT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// a comparison of evaluated terms, which the machine does in place
+static bool comparison(const AstPtr& a) {
+    if (a->tag() != AST_EXPR_APPLICATION) return false;
+    AST_EXPR_APPLICATION_SPLIT(a, p, aa);
+    auto o = aa[0];
+    if (aa.size() != 3 || o->tag() != AST_EXPR_COMBINATOR) return false;
+    AST_EXPR_COMBINATOR_SPLIT(o, p0, nn, n);
+    return nn.empty() &&
+           (n == "System:<" || n == "System:<=" || n == "System:==" || n == "System:!=") &&
+           evaluated(aa[1]) && evaluated(aa[2]);
+}
+
+// a let which binds an evaluated term to a variable, or discards it
+static bool binding(const AstPtrs& ll, const AstPtr& r) {
+    return (ll.size() == 1) && evaluated(r) &&
+           (ll[0]->tag() == AST_EXPR_VARIABLE || ll[0]->tag() == AST_EXPR_WILDCARD);
+}
+
+// conditionals and lets which are the result of a match, or of such a 
+// kept conditional or let, and whose scrutinee is evaluated are kept, 
+// the code generator compiles them to branches and bindings. the root
+// flag is cleared on entering any term such that only these positions
+// are roots
+class RewriteRoot: public Rewrite {
 public:
-    AstPtr condition(const AstPtr& a) {
+    RewriteRoot(): _root(false), _here(false) {
+    }
+
+    void rewrite_pre(const AstPtr& a) override {
+        _here = _root;
+        _root = false;
+    }
+
+    // whether the term being rewritten is a root, to be read on entry
+    bool root() const {
+        return _here;
+    }
+
+    AstPtr rewrite_root(const AstPtr& a) {
+        _root = true;
         return rewrite(a);
     }
 
-    //  F(if i then t else e) -> ([ true -> F(t) | _ -> F(e) ] F(i))
+    AstPtr rewrite_expr_match(const Position& p, const AstPtrs& mm, const AstPtr& g, const AstPtr& e) override {
+        auto mm0 = rewrites(mm);
+        auto g0 = rewrite(g);
+        auto e0 = rewrite_root(e);
+        return AstExprMatch(p, mm0, g0, e0).clone();
+    }
+
     AstPtr rewrite_expr_if(const Position& p, const AstPtr& i, const AstPtr& t, const AstPtr& e) override {
+        bool r = root();
         auto i0 = rewrite(i);
-        auto t0 = rewrite(t);
-        auto e0 = rewrite(e);
+        if (r && (evaluated(i0) || comparison(i0))) {
+            return AstExprIf(p, i0, rewrite_root(t), rewrite_root(e)).clone();
+        } else {
+            return rewrite_expr_if_lifted(p, i0, rewrite(t), rewrite(e));
+        }
+    }
+
+    AstPtr rewrite_expr_let(const Position& p, const AstPtrs& ll, const AstPtr& r, const AstPtr& b) override {
+        bool rt = root();
+        auto ll0 = rewrites(ll);
+        auto r0 = rewrite(r);
+        if (rt && binding(ll0, r0)) {
+            return AstExprLet(p, ll0, r0, rewrite_root(b)).clone();
+        } else {
+            return rewrite_expr_let_lifted(p, ll0, r0, rewrite(b));
+        }
+    }
+
+    virtual AstPtr rewrite_expr_if_lifted(const Position& p, const AstPtr& i, const AstPtr& t, const AstPtr& e) {
+        return AstExprIf(p, i, t, e).clone();
+    }
+
+    virtual AstPtr rewrite_expr_let_lifted(const Position& p, const AstPtrs& ll, const AstPtr& r, const AstPtr& b) {
+        return AstExprLet(p, ll, r, b).clone();
+    }
+
+private:
+    bool    _root;
+    bool    _here;
+};
+
+class RewriteCondition: public RewriteRoot {
+public:
+    AstPtr condition(const AstPtr& a) {
+        return rewrite(a);
+    }
+
+    //  F(if i then t else e) -> ([ true -> F(t) | _ -> F(e) ] F(i))
+    AstPtr rewrite_expr_if_lifted(const Position& p, const AstPtr& i0, const AstPtr& t0, const AstPtr& e0) override {
 
         auto a0 = AstExprCombinator(p, STRING_SYSTEM, STRING_TRUE).clone();
         AstPtrs aa0;
@@ -167,17 +263,14 @@ AstPtr pass_lambda(const AstPtr& a) {
     return lambda.lambda(a);
 }
 
-class RewriteLet: public Rewrite {
+class RewriteLet: public RewriteRoot {
 public:
     AstPtr let(const AstPtr& a) {
         return rewrite(a);
     }
 
     //  F( (let l = r in b) ) -> ( [ l -> F(b) ] F(r) )
-    AstPtr rewrite_expr_let(const Position& p, const AstPtrs& ll, const AstPtr& r, const AstPtr& b) override {
-        auto r0 = rewrite(r);
-        auto b0 = rewrite(b);
-
+    AstPtr rewrite_expr_let_lifted(const Position& p, const AstPtrs& ll, const AstPtr& r0, const AstPtr& b0) override {
         auto m = AstExprMatch(p, ll, AstEmpty().clone(), b0).clone();
 
         AstPtrs mm;
@@ -31,6 +31,9 @@
 #define INCLUDE_PATH \
     "/usr/local/lib/egel"
 
+#define PROFILE_FILE \
+    "egel.folded"
+
 typedef enum {
     OPTION_NONE,
     OPTION_FILE,
@@ -58,6 +61,10 @@ static option_t options[] = {
     { "-D", "--desugar", OPTION_NONE, "output desugared tree (debug)", },
     { "-C", "--lift",    OPTION_NONE, "output combinator lifted tree (debug)", },
     { "-B", "--bytes",   OPTION_NONE, "output bytecode (debug)", },
+    { "-G", "--gc",      OPTION_TEXT, "memory management: refcount (default), or tracing to also collect reference cycles, single-threaded only", },
+    { "-S", "--stats",   OPTION_NONE, "report runtime statistics at exit", },
+    { "-P", "--profile", OPTION_NONE, "profile combinators, stacks are written to " PROFILE_FILE, },
+    { "-M", "--image",   OPTION_FILE, "start from an image of the loaded program, written when stale", },
 };
 
 #define OPTIONS_SIZE    (sizeof(options)/sizeof(option_t))
@@ -70,6 +77,15 @@ StringPairs parse_options(int argc, char *argv[]) {
         uint_t sz = pp.size();
 
         for(uint_t i = 0; i < OPTIONS_SIZE; i++) {
+
+            // also accept --name=value for options with an argument
+            auto ln = strlen(options[i].longname);
+            if ( (options[i].argument != OPTION_NONE) &&
+                 (strncmp(argv[a], options[i].longname, ln) == 0) && 
+                 (argv[a][ln] == '=') ) {
+                pp.push_back(std::make_pair(icu::UnicodeString(options[i].shortname), icu::UnicodeString(argv[a] + ln + 1)));
+                continue;
+            }
             
             if ( (strncmp(argv[a], options[i].shortname, 32) == 0) ||
                  (strncmp(argv[a], options[i].longname, 32) == 0) ) {
@@ -211,6 +227,25 @@ int main(int argc, char *argv[]) {
         if (p.first == ("-B")) {
             oo->set_bytecode(true);
         };
+        if (p.first == ("-S")) {
+            vm_statistics = true;
+        };
+        if (p.first == ("-G")) {
+            if (p.second == "tracing") {
+                vm_object_tracing = true;
+            } else if (p.second != "refcount") {
+                std::cerr << "unknown memory management: " << p.second << std::endl;
+                return (EXIT_FAILURE);
+            }
+        };
+    };
+
+    // check for profiling
+    bool profile = false;
+    for (auto& p : pp) {
+        if (p.first == ("-P")) {
+            profile = true;
+        };
     };
 
     // check for unique --/fn
@@ -226,6 +261,14 @@ int main(int argc, char *argv[]) {
         }
     };
 
+    // check for an image, compiler debugging bypasses it
+    icu::UnicodeString image;
+    for (auto& p : pp) {
+        if (p.first == ("-M") && !oo->debugging()) {
+            image = p.second;
+        };
+    };
+
     // check for command
     icu::UnicodeString e;
     for (auto& p : pp) {
@@ -253,7 +296,11 @@ int main(int argc, char *argv[]) {
     // load the file
     if (fn != "") {
         try {
-            eval.eval_load(fn);
+            if (image != "") {
+                eval.eval_image(image, fn);
+            } else {
+                eval.eval_load(fn);
+            }
         } catch (Error &e) {
             std::cerr << e << std::endl;
             return (EXIT_FAILURE);
@@ -264,6 +311,8 @@ int main(int argc, char *argv[]) {
     application_argc = argc;
     application_argv = argv;
 
+    if (profile) Profiler::start();
+
     // start either interactive or batch mode
     if (e != "") {
         eval.eval_command(icu::UnicodeString("using System"));
@@ -274,5 +323,17 @@ int main(int argc, char *argv[]) {
         eval.eval_main();
     }
 
+    if (profile) {
+        Profiler::stop();
+        std::ofstream folded(PROFILE_FILE);
+        Profiler::report(&m, std::cerr, folded);
+    }
+
+    if (vm_statistics) {
+        for (auto& s : m.statistics()) {
+            std::cerr << std::left << std::setw(32) << s.first << s.second << std::endl;
+        }
+    }
+
     return EXIT_SUCCESS;
 }
@@ -49,12 +49,59 @@ typedef enum {
 //    EMIT_EXPR_CONSTANT, // XXX constant optimization not implemented yet
 } emit_state_t;
 
+// the registers which link a thunk under construction to its parent
+typedef struct {
+    reg_t   rt;
+    reg_t   rti;
+    reg_t   k;
+    reg_t   exc;
+} link_registers_t;
+
+// a row in a match matrix: the patterns left to match, one per column,
+// the variables bound so far, and the result
+typedef struct {
+    AstPtrs     patterns;
+    RegisterMap bindings;
+    AstPtr      result;
+} MatchRow;
+
+typedef std::vector<MatchRow>       MatchRows;
+typedef std::vector<reg_t>          MatchColumns;
+typedef std::pair<bool, uint_t>     MatchKey;   // split size, or data
+
+// an argument split as a constructor, its array may be reused for a 
+// constructor of the same size in the result
+typedef struct {
+    reg_t   r;      // the register holding it
+    index_t i;      // its slot in the frame
+    uint_t  size;
+} match_cell_t;
+
+typedef std::vector<match_cell_t>   MatchCells;
+
+typedef enum {
+    MATCH_VARIABLE,
+    MATCH_TAG,
+    MATCH_CONSTRUCTOR,
+} match_class_t;
+
 class EmitCode: public Visit {
 public:
-    void emit(VM* vm, const AstPtr& a) {
+    VMObjectPtrs emit(VM* vm, const AstPtr& a) {
         _machine = vm;
+        _defined.clear();
         _coder = std::unique_ptr<Coder>(new Coder());
+        _self = 0;
+        _nil = vm->enter_symbol(STRING_SYSTEM, STRING_NIL);
+        _cons = vm->enter_symbol(STRING_SYSTEM, STRING_CONS);
+        _tuple = vm->enter_symbol(STRING_SYSTEM, STRING_TUPLE);
+        _entry = link_registers_t{0, 0, 0, 0};
+        _tail = false;
+        _arguments.clear();
+        _cells.clear();
+        _reusable.clear();
         visit(a);
+        return _defined;
     }
 
     void set_state(const emit_state_t s) {
@@ -113,6 +160,17 @@ public:
         return _register_exc;
     }
 
+    link_registers_t get_link_registers() const {
+        return link_registers_t{_register_rt, _register_rti, _register_k, _register_exc};
+    }
+
+    void set_link_registers(const link_registers_t& ll) {
+        _register_rt  = ll.rt;
+        _register_rti = ll.rti;
+        _register_k   = ll.k;
+        _register_exc = ll.exc;
+    }
+
     void set_current_register(reg_t r) {
         _current_reg = r;
     }
@@ -137,6 +195,19 @@ public:
         return _arity;
     }
 
+    void set_self(const symbol_t s) {
+        _self = s;
+        _entry = get_link_registers();
+    }
+
+    void set_tail(bool t) {
+        _tail = t;
+    }
+
+    bool get_tail() const {
+        return _tail;
+    }
+
     void add_variable_binding(const icu::UnicodeString& v, const reg_t t) {
         _variables[v] = t;
     }
@@ -146,7 +217,16 @@ public:
     }
 
 
-    void visit_constant(const data_t& d) {
+    // a constant in normal form is set in its parent as a value, other 
+    // constants, combinators which may reduce, are passed in a thunk
+    void visit_constant(const data_t& d, bool normal = true) {
+        if (normal && get_state() == EMIT_EXPR) {
+            auto c = get_coder()->generate_register();
+            get_coder()->emit_op_data(c, d);
+            get_coder()->emit_op_set(get_register_rt(), get_register_rti(), c);
+            return;
+        }
+
         switch(get_state()) {
         case EMIT_PATTERN: {
             auto r = get_current_register();
@@ -192,40 +272,55 @@ public:
         }
     }
 
-    void visit_expr_integer(const Position& p, const icu::UnicodeString& v) override {
+    data_t data_integer(const icu::UnicodeString& v) {
         if (v.startsWith("0x")) {
             auto i = VMObjectInteger(convert_to_hexint(v)).clone();
-            auto d = get_machine()->enter_data(i);
-            visit_constant(d);
+            return get_machine()->enter_data(i);
         } else {
             auto i = VMObjectInteger(convert_to_int(v)).clone();
-            auto d = get_machine()->enter_data(i);
-            visit_constant(d);
+            return get_machine()->enter_data(i);
         }
     }
 
-    void visit_expr_float(const Position& p, const icu::UnicodeString& v) override {
+    data_t data_float(const icu::UnicodeString& v) {
         auto i = VMObjectFloat(convert_to_float(v)).clone();
-        auto d = get_machine()->enter_data(i);
-        visit_constant(d);
+        return get_machine()->enter_data(i);
     }
 
-    void visit_expr_character(const Position& p, const icu::UnicodeString& v) override {
+    data_t data_character(const icu::UnicodeString& v) {
         auto i = VMObjectChar(convert_to_char(v)).clone();
-        auto d = get_machine()->enter_data(i);
-        visit_constant(d);
+        return get_machine()->enter_data(i);
     }
 
-    void visit_expr_text(const Position& p, const icu::UnicodeString& v) override {
+    data_t data_text(const icu::UnicodeString& v) {
         auto i = VMObjectText(convert_to_text(v)).clone();
-        auto d = get_machine()->enter_data(i);
-        visit_constant(d);
+        return get_machine()->enter_data(i);
+    }
+
+    data_t data_combinator(const UnicodeStrings& nn, const icu::UnicodeString& n) {
+        auto c = get_machine()->get_data_string(nn, n);
+        return get_machine()->enter_data(c);
+    }
+
+    void visit_expr_integer(const Position& p, const icu::UnicodeString& v) override {
+        visit_constant(data_integer(v));
+    }
+
+    void visit_expr_float(const Position& p, const icu::UnicodeString& v) override {
+        visit_constant(data_float(v));
+    }
+
+    void visit_expr_character(const Position& p, const icu::UnicodeString& v) override {
+        visit_constant(data_character(v));
+    }
+
+    void visit_expr_text(const Position& p, const icu::UnicodeString& v) override {
+        visit_constant(data_text(v));
     }
 
     void visit_expr_combinator(const Position& p, const UnicodeStrings& nn, const icu::UnicodeString& n) override {
         auto c = get_machine()->get_data_string(nn, n);
-        auto d = get_machine()->enter_data(c);
-        visit_constant(d);
+        visit_constant(get_machine()->enter_data(c), constructor(c) || arity(c) > 0);
     }
 
     void visit_expr_operator(const Position& p, const UnicodeStrings& nn, const icu::UnicodeString& n) override {
@@ -303,94 +398,455 @@ public:
         case EMIT_EXPR_ROOT:
         case EMIT_EXPR: { //XXX
 
-            // generate labels rt, rti, k, exc, c, x .. y
-            auto rt  = get_coder()->generate_register();
-            auto rti = get_coder()->generate_register();
-            auto k   = get_coder()->generate_register();
-            auto exc = get_coder()->generate_register();
-            auto c   = get_coder()->generate_register();
-
-            reg_t x = 0, y = 0;
-            uint_t sz = aa.size();
-            for (uint_t n = 1; n < sz; n++) {
-                y = get_coder()->generate_register();
-                if (n==1) x = y;
+            if (get_state() == EMIT_EXPR_ROOT && tail_call(aa)) {
+                emit_tail_call(aa);
+                break;
             }
 
-            // generate thunk label
-            auto t   = get_coder()->generate_register();
+            if (construction(aa)) {
+                emit_construction(aa);
+                break;
+            }
 
-            // fill rt, rti, k, exc, c, x .. y
-            get_coder()->emit_op_mov(rt, get_register_rt());
-            get_coder()->emit_op_mov(rti, get_register_rti());
-            get_coder()->emit_op_mov(k, get_register_k());
-            get_coder()->emit_op_mov(exc, get_register_exc());
+            // a partial application is a value, except in root position
+            // where there may be extra arguments to apply it to
+            if (get_state() == EMIT_EXPR && unsaturated(aa)) {
+                emit_construction(aa);
+                break;
+            }
 
-            auto a = aa[0];
-            bool head_flag; // generate more efficient code for vars and combinators
-            if (a->tag() == AST_EXPR_VARIABLE) {
-                AST_EXPR_VARIABLE_SPLIT(a, p, n);
-                auto r = get_variable_binding(n);
-                get_coder()->emit_op_mov(c, r);
-                head_flag = true;
-            } else if (a->tag() == AST_EXPR_COMBINATOR) {
-                AST_EXPR_COMBINATOR_SPLIT(a, p, nn, n);
-                auto v = get_machine()->get_data_string(nn, n);
-                auto d = get_machine()->enter_data(v);
-                get_coder()->emit_op_data(c, d);
-                head_flag = true;
-            } else {
-                get_coder()->emit_op_nil(c);
-                head_flag = false;
+            if (operation(aa)) {
+                emit_operation(aa);
+                break;
             }
 
-            reg_t z = x;
-            for (uint_t n = 1; n < sz; n++) {
-                get_coder()->emit_op_nil(z);
-                z++;
+            emit_application(aa);
+            break;
             }
-            get_coder()->emit_op_array(t, rt, y);
+        }
+    }
 
-            // adjust for root
-            auto root   = get_coder()->generate_register();
-            auto state  = get_state();
-            if (state == EMIT_EXPR_ROOT) {
-                set_state(EMIT_EXPR);
-                auto f   = get_register_frame();
+    // an application is built as a thunk, its arguments are reduced
+    // into its slots before it is reduced
+    void emit_application(const AstPtrs& aa) {
+        // generate labels rt, rti, k, exc, c, x .. y
+        auto rt  = get_coder()->generate_register();
+        auto rti = get_coder()->generate_register();
+        auto k   = get_coder()->generate_register();
+        auto exc = get_coder()->generate_register();
+        auto c   = get_coder()->generate_register();
+
+        reg_t x = 0, y = 0;
+        uint_t sz = aa.size();
+        for (uint_t n = 1; n < sz; n++) {
+            y = get_coder()->generate_register();
+            if (n==1) x = y;
+        }
+
+        // generate thunk label
+        auto t   = get_coder()->generate_register();
+
+        // fill rt, rti, k, exc, c, x .. y
+        get_coder()->emit_op_mov(rt, get_register_rt());
+        get_coder()->emit_op_mov(rti, get_register_rti());
+        get_coder()->emit_op_mov(k, get_register_k());
+        get_coder()->emit_op_mov(exc, get_register_exc());
+
+        auto a = aa[0];
+        bool head_flag; // generate more efficient code for vars and combinators
+        if (a->tag() == AST_EXPR_VARIABLE) {
+            AST_EXPR_VARIABLE_SPLIT(a, p, n);
+            auto r = get_variable_binding(n);
+            get_coder()->emit_op_mov(c, r);
+            head_flag = true;
+        } else if (a->tag() == AST_EXPR_COMBINATOR) {
+            AST_EXPR_COMBINATOR_SPLIT(a, p, nn, n);
+            auto v = get_machine()->get_data_string(nn, n);
+            auto d = get_machine()->enter_data(v);
+            get_coder()->emit_op_data(c, d);
+            head_flag = true;
+        } else {
+            get_coder()->emit_op_nil(c);
+            head_flag = false;
+        }
+
+        reg_t z = x;
+        for (uint_t n = 1; n < sz; n++) {
+            get_coder()->emit_op_nil(z);
+            z++;
+        }
+        get_coder()->emit_op_array(t, rt, y);
+
+        // adjust for root
+        auto root   = get_coder()->generate_register();
+        auto state  = get_state();
+        if (state == EMIT_EXPR_ROOT) {
+            set_state(EMIT_EXPR);
+            auto f   = get_register_frame();
 
-                get_coder()->emit_op_concatx(root, t, f, 5 + get_arity());
+            get_coder()->emit_op_concatx(root, t, f, 5 + get_arity());
+        } else {
+            root = t; // XXX: no mov?
+        }
+        k = root; set_register_k(k);
+        rt = root; set_register_rt(rt);
+
+        // generate thunks for nil fields
+        if (!head_flag) {
+            auto i = VMObjectInteger(4).clone();
+            auto d = get_machine()->enter_data(i);
+            get_coder()->emit_op_data(rti, d);
+
+            set_register_rt(rt);
+            set_register_rti(rti);
+
+            visit(aa[0]);
+        }
+
+        for (uint_t n = 1; n < sz; n++) {
+            auto i = VMObjectInteger(n+4).clone();
+            auto d = get_machine()->enter_data(i);
+            reg_t q = get_coder()->generate_register();
+            get_coder()->emit_op_data(q, d);
+
+            set_register_rt(rt);
+            set_register_rti(q);
+
+            visit(aa[n]);
+        }
+    }
+
+    // a saturated call to the combinator being defined, in root position
+    // and with the links it was entered with, whose arguments need no 
+    // reduction or are primitive operations can overwrite the frame and
+    // restart instead of bouncing through the trampoline
+    bool tail_call(const AstPtrs& aa) {
+        auto a = aa[0];
+        symbol_t s;
+        if (a->tag() == AST_EXPR_COMBINATOR) {
+            AST_EXPR_COMBINATOR_SPLIT(a, p, nn, n);
+            s = get_machine()->enter_symbol(nn, n);
+        } else if (a->tag() == AST_EXPR_OPERATOR) {
+            AST_EXPR_OPERATOR_SPLIT(a, p, nn, n);
+            s = get_machine()->enter_symbol(nn, n);
+        } else {
+            return false;
+        }
+        if (s != _self || aa.size() != get_arity() + 1) return false;
+
+        auto ll = get_link_registers();
+        if (ll.rt != _entry.rt || ll.rti != _entry.rti || ll.k != _entry.k || ll.exc != _entry.exc) {
+            return false;
+        }
+
+        for (uint_t n = 1; n < aa.size(); n++) {
+            if (!normal_form(aa[n]) && !operand(aa[n])) return false;
+        }
+        return true;
+    }
+
+    // arithmetic the machine doesn't handle leaves to the ordinary
+    // application of the combinator
+    void emit_tail_call(const AstPtrs& aa) {
+        auto l = get_coder()->generate_label();
+        reg_t x = 0, y = 0;
+        for (uint_t n = 1; n < aa.size(); n++) {
+            y = get_coder()->generate_register();
+            if (n == 1) x = y;
+        }
+
+        bool fallback = false;
+        reg_t r = x;
+        for (uint_t n = 1; n < aa.size(); n++) {
+            if (normal_form(aa[n])) {
+                get_coder()->emit_op_mov(r, emit_value(aa[n]));
             } else {
-                root = t; // XXX: no mov?
+                get_coder()->emit_op_mov(r, emit_operand(aa[n], l));
+                fallback = fallback || partial(aa[n]);
             }
-            k = root; set_register_k(k);
-            rt = root; set_register_rt(rt);
+            r++;
+        }
 
-            // generate thunks for nil fields
-            if (!head_flag) {
-                auto i = VMObjectInteger(4).clone();
-                auto d = get_machine()->enter_data(i);
-                get_coder()->emit_op_data(rti, d);
+        get_coder()->emit_op_tail(get_register_frame(), x, y);
 
-                set_register_rt(rt);
-                set_register_rti(rti);
+        if (fallback) {
+            get_coder()->emit_label(l);
+            emit_application(aa);
+            get_coder()->emit_op_return(get_register_k());
+        }
+        set_tail(true);
+    }
 
-                visit(aa[0]);
-            }
+    // a data constructor, which reduces to itself. definitions may be
+    // replaced in the interpreter, only the list and tuple constructors
+    // are known to stay data, other data is reduced like any combinator
+    bool constructor(const VMObjectPtr& c) {
+        if (c->flag() != VM_OBJECT_FLAG_DATA) return false;
+        auto s = c->symbol();
+        return s == _nil || s == _cons || s == _tuple;
+    }
+
+    bool constructor(const AstPtr& a) {
+        if (a->tag() == AST_EXPR_COMBINATOR) {
+            AST_EXPR_COMBINATOR_SPLIT(a, p, nn, n);
+            return constructor(get_machine()->get_data_string(nn, n));
+        } else if (a->tag() == AST_EXPR_OPERATOR) {
+            AST_EXPR_OPERATOR_SPLIT(a, p, nn, n);
+            return constructor(get_machine()->get_data_string(nn, n));
+        } else {
+            return false;
+        }
+    }
+
+    // a data constructor applied to arguments
+    bool construction(const AstPtrs& aa) {
+        return (aa.size() > 1) && constructor(aa[0]);
+    }
+
+    // the arity of a builtin, or unknown for anything else. definitions
+    // may be replaced in the interpreter, possibly with another arity, 
+    // bytecode checks its arity when it is reduced instead
+    int arity(const VMObjectPtr& c) {
+        if (c->tag() != VM_OBJECT_COMBINATOR || c->flag() != VM_OBJECT_FLAG_INTERNAL) return VM_ARITY_UNKNOWN;
+        return VM_OBJECT_COMBINATOR_CAST(c)->arity();
+    }
 
-            for (uint_t n = 1; n < sz; n++) {
-                auto i = VMObjectInteger(n+4).clone();
-                auto d = get_machine()->enter_data(i);
-                reg_t q = get_coder()->generate_register();
-                get_coder()->emit_op_data(q, d);
+    int arity(const AstPtr& a) {
+        if (a->tag() == AST_EXPR_COMBINATOR) {
+            AST_EXPR_COMBINATOR_SPLIT(a, p, nn, n);
+            return arity(get_machine()->get_data_string(nn, n));
+        } else if (a->tag() == AST_EXPR_OPERATOR) {
+            AST_EXPR_OPERATOR_SPLIT(a, p, nn, n);
+            return arity(get_machine()->get_data_string(nn, n));
+        } else {
+            return VM_ARITY_UNKNOWN;
+        }
+    }
 
-                set_register_rt(rt);
-                set_register_rti(q);
+    // a builtin applied to fewer arguments than its arity, which reduces
+    // to itself applied to them and is built like a construction
+    bool unsaturated(const AstPtrs& aa) {
+        return (int) aa.size() - 1 < arity(aa[0]);
+    }
 
-                visit(aa[n]);
+    // a term known to be in normal form needs no reduction: literals,
+    // variables, which are bound to reduced terms, the list and tuple
+    // constructors and builtins awaiting arguments, and constructions and
+    // partial applications of terms in normal form
+    bool normal_form(const AstPtr& a) {
+        switch (a->tag()) {
+        case AST_EXPR_VARIABLE:
+        case AST_EXPR_INTEGER:
+        case AST_EXPR_FLOAT:
+        case AST_EXPR_CHARACTER:
+        case AST_EXPR_TEXT:
+            return true;
+        case AST_EXPR_COMBINATOR:
+        case AST_EXPR_OPERATOR:
+            return constructor(a) || arity(a) > 0;
+        case AST_EXPR_APPLICATION: {
+            AST_EXPR_APPLICATION_SPLIT(a, p, aa);
+            if (!construction(aa) && !unsaturated(aa)) return false;
+            for (uint_t n = 1; n < aa.size(); n++) {
+                if (!normal_form(aa[n])) return false;
+            }
+            return true;
             }
+        default:
+            return false;
+        }
+    }
 
-            break;
+    // the register holding a term in normal form, constructions are built
+    // in place without thunks
+    reg_t emit_value(const AstPtr& a) {
+        switch (a->tag()) {
+        case AST_EXPR_VARIABLE: {
+            AST_EXPR_VARIABLE_SPLIT(a, p, v);
+            return get_variable_binding(v);
+            }
+        case AST_EXPR_APPLICATION: {
+            AST_EXPR_APPLICATION_SPLIT(a, p, aa);
+            reg_t x = 0, y = 0;
+            for (uint_t n = 0; n < aa.size(); n++) {
+                y = get_coder()->generate_register();
+                if (n == 0) x = y;
+            }
+            reg_t r = x;
+            for (auto& b:aa) {
+                get_coder()->emit_op_mov(r, emit_value(b));
+                r++;
             }
+            auto t = get_coder()->generate_register();
+            get_coder()->emit_op_array(t, x, y);
+            return t;
+            }
+        default: {
+            auto r = get_coder()->generate_register();
+            get_coder()->emit_op_data(r, match_key(a).second);
+            return r;
+            }
+        }
+    }
+
+    // a constructed value is written to its parent before its arguments
+    // are reduced into its slots, and is built in the array of a matched 
+    // argument of the same size when nothing else refers to that anymore
+    void emit_construction(const AstPtrs& aa) {
+        uint_t sz = aa.size();
+
+        auto c = get_coder()->generate_register();
+        reg_t x = 0, y = 0;
+        for (uint_t n = 1; n < sz; n++) {
+            y = get_coder()->generate_register();
+            if (n == 1) x = y;
+        }
+        auto t = get_coder()->generate_register();
+
+        auto a = aa[0];
+        auto d = match_key(a).second;
+        get_coder()->emit_op_data(c, d);
+
+        auto cell = std::find_if(_reusable.begin(), _reusable.end(), 
+                                 [sz](const match_cell_t& m) { return m.size == sz; });
+        if (cell != _reusable.end()) {
+            get_coder()->emit_op_reuse(t, cell->r, get_register_frame(), cell->i);
+            auto q = get_coder()->generate_register();
+            get_coder()->emit_op_data(q, get_machine()->enter_data(VMObjectInteger(0).clone()));
+            get_coder()->emit_op_set(t, q, c);
+            _reusable.erase(cell);
+        } else {
+            for (reg_t r = x; r <= y; r++) get_coder()->emit_op_nil(r);
+            get_coder()->emit_op_array(t, c, y);
+        }
+
+        auto root = t;
+        if (get_state() == EMIT_EXPR_ROOT) {
+            set_state(EMIT_EXPR);
+            root = get_coder()->generate_register();
+            get_coder()->emit_op_concatx(root, t, get_register_frame(), 5 + get_arity());
+        }
+        get_coder()->emit_op_set(get_register_rt(), get_register_rti(), root);
+
+        for (uint_t n = 1; n < sz; n++) {
+            auto q = get_coder()->generate_register();
+            get_coder()->emit_op_data(q, get_machine()->enter_data(VMObjectInteger(n).clone()));
+
+            set_register_rt(root);
+            set_register_rti(q);
+
+            visit(aa[n]);
+        }
+    }
+
+    // the instruction for a builtin operator the machine does itself
+    bool primitive(const AstPtr& a, opcode_t& op) {
+        static const std::map<icu::UnicodeString, opcode_t> primitives = {
+            { "System:+", OP_ADD }, { "System:-", OP_SUB }, { "System:*", OP_MUL },
+            { "System:/", OP_DIV }, { "System:%", OP_MOD },
+            { "System:<", OP_LT }, { "System:<=", OP_LE }, { "System:==", OP_EQ }, { "System:!=", OP_NE },
+        };
+        if (a->tag() != AST_EXPR_COMBINATOR) return false;
+        AST_EXPR_COMBINATOR_SPLIT(a, p, nn, n);
+        if (!nn.empty()) return false;
+        auto i = primitives.find(n);
+        if (i == primitives.end()) return false;
+        op = i->second;
+        return true;
+    }
+
+    // an operand of a primitive is a variable, a literal, or a primitive
+    // operation itself
+    bool operand(const AstPtr& a) {
+        switch (a->tag()) {
+        case AST_EXPR_VARIABLE:
+        case AST_EXPR_INTEGER:
+        case AST_EXPR_FLOAT:
+        case AST_EXPR_CHARACTER:
+        case AST_EXPR_TEXT:
+            return true;
+        case AST_EXPR_APPLICATION: {
+            AST_EXPR_APPLICATION_SPLIT(a, p, aa);
+            return operation(aa);
+            }
+        default:
+            return false;
+        }
+    }
+
+    // a builtin operator applied to two operands
+    bool operation(const AstPtrs& aa) {
+        opcode_t op = OP_NIL;
+        return (aa.size() == 3) && primitive(aa[0], op) && operand(aa[1]) && operand(aa[2]);
+    }
+
+    // whether an operation holds arithmetic which may leave to the builtin
+    bool partial(const AstPtrs& aa) {
+        opcode_t op = OP_NIL;
+        primitive(aa[0], op);
+        return OP_IS_ARITHMETIC(op) || partial(aa[1]) || partial(aa[2]);
+    }
+
+    bool partial(const AstPtr& a) {
+        if (a->tag() != AST_EXPR_APPLICATION) return false;
+        AST_EXPR_APPLICATION_SPLIT(a, p, aa);
+        return partial(aa);
+    }
+
+    // the register holding an operand, arithmetic the machine doesn't
+    // handle jumps to l
+    reg_t emit_operand(const AstPtr& a, const label_t l) {
+        if (a->tag() != AST_EXPR_APPLICATION) return emit_value(a);
+        AST_EXPR_APPLICATION_SPLIT(a, p, aa);
+        return emit_operand(aa, l);
+    }
+
+    reg_t emit_operand(const AstPtrs& aa, const label_t l) {
+        opcode_t op = OP_NIL;
+        primitive(aa[0], op);
+        auto y = emit_operand(aa[1], l);
+        auto z = emit_operand(aa[2], l);
+        auto x = get_coder()->generate_register();
+        if (OP_IS_ARITHMETIC(op)) {
+            get_coder()->emit_op_arithmetic(op, x, y, z, l);
+        } else {
+            get_coder()->emit_op_comparison(op, x, y, z);
+        }
+        return x;
+    }
+
+    // a primitive operation is done in place, the builtin is applied in
+    // a thunk when the operands are of another kind, and in root position
+    // when there are extra arguments to apply the result to
+    void emit_operation(const AstPtrs& aa) {
+        auto l   = get_coder()->generate_label();
+        auto rt  = get_register_rt();
+        auto rti = get_register_rti();
+
+        if (get_state() == EMIT_EXPR_ROOT) {
+            get_coder()->emit_op_jna(get_register_frame(), 5 + get_arity(), l);
+            auto x = emit_operand(aa, l);
+            get_coder()->emit_op_set(rt, rti, x);
+            get_coder()->emit_op_return(get_register_k());
+            get_coder()->emit_label(l);
+            emit_application(aa);
+        } else if (partial(aa)) {
+            auto j = get_coder()->generate_label();
+            auto k = get_coder()->generate_register();
+            auto x = emit_operand(aa, l);
+            get_coder()->emit_op_set(rt, rti, x);
+            get_coder()->emit_op_mov(k, get_register_k());
+            get_coder()->emit_op_jmp(j);
+            get_coder()->emit_label(l);
+            emit_application(aa);
+            get_coder()->emit_op_mov(k, get_register_k());
+            get_coder()->emit_label(j);
+            set_register_k(k);
+            set_register_rt(rt);
+            set_register_rti(rti);
+        } else {
+            auto x = emit_operand(aa, l);
+            get_coder()->emit_op_set(rt, rti, x);
         }
     }
 
@@ -430,6 +886,62 @@ public:
         }
     }
 
+    // emit a result, which ends with a return or a restart
+    void emit_root(const AstPtr& a, const link_registers_t& links, const MatchCells& reusable) {
+        auto member = get_coder()->peek_register();
+
+        set_link_registers(links);
+        set_state(EMIT_EXPR_ROOT);
+        set_tail(false);
+        _reusable = reusable;
+        visit(a);
+
+        if (!get_tail()) {
+            auto k = get_register_k();
+            get_coder()->emit_op_return(k);
+        }
+
+        get_coder()->restore_register(member);
+    }
+
+    // a conditional on an evaluated term in root position branches within
+    // the frame, anything but true selects the else branch
+    void visit_expr_if(const Position& p, const AstPtr& i, const AstPtr& t, const AstPtr& e) override {
+        if (get_state() != EMIT_EXPR_ROOT) PANIC("conditional not in root position");
+
+        auto links = get_link_registers();
+        auto reusable = _reusable;
+        auto l = get_coder()->generate_label();
+
+        auto r = emit_operand(i, l);
+        auto rt = get_coder()->generate_register();
+        get_coder()->emit_op_data(rt, data_combinator(UnicodeStrings{STRING_SYSTEM}, STRING_TRUE));
+        get_coder()->emit_op_test(r, rt);
+        get_coder()->emit_op_fail(l);
+
+        emit_root(t, links, reusable);
+        get_coder()->emit_label(l);
+        emit_root(e, links, reusable);
+
+        // both branches ended
+        set_tail(true);
+    }
+
+    // a let of an evaluated term in root position binds its register
+    void visit_expr_let(const Position& p, const AstPtrs& ll, const AstPtr& r, const AstPtr& b) override {
+        if (get_state() != EMIT_EXPR_ROOT) PANIC("let not in root position");
+
+        auto variables = _variables;
+        auto x = emit_value(r);
+        auto l = ll[0];
+        if (l->tag() == AST_EXPR_VARIABLE) {
+            AST_EXPR_VARIABLE_SPLIT(l, p0, v);
+            add_variable_binding(v, x);
+        }
+        visit(b);
+        _variables = variables;
+    }
+
     void visit_expr_match(const Position& p, const AstPtrs& mm, const AstPtr& g, const AstPtr& e) override {
         // we have memberberries
         auto member = get_coder()->peek_register();
@@ -460,11 +972,15 @@ public:
         }
 
         set_state(EMIT_EXPR_ROOT);
+        set_tail(false);
+        _reusable.clear();
         visit(e);
 
-        // all matches end with a return
-        auto k = get_register_k();
-        get_coder()->emit_op_return(k);
+        // all matches end with a return, or restart on a tail call
+        if (!get_tail()) {
+            auto k = get_register_k();
+            get_coder()->emit_op_return(k);
+        }
 
         // generate a label at the end of the match
         get_coder()->emit_label(l);
@@ -474,20 +990,391 @@ public:
 
     void visit_expr_block(const Position& p, const AstPtrs& alts) override {
         // keep link registers invariant
-        auto rt = get_register_rt();
-        auto rti = get_register_rti();
-        auto k = get_register_k();
-        auto exc = get_register_exc();
+        auto links = get_link_registers();
+
+        if (matchable(alts)) {
+            emit_match_block(alts, links);
+            return;
+        }
 
         for (auto& a:alts) {
-            set_register_rt(rt);
-            set_register_rti(rti);
-            set_register_k(k);
-            set_register_exc(exc);
+            set_link_registers(links);
             visit(a);
         }
     }
 
+    // a block is compiled as a backtracking automaton over the patterns 
+    // of consecutive alternatives of the same arity. every column is 
+    // inspected once per switch, a block in which the first refutable
+    // column is a variable, tag, or constructor is tried as a whole 
+    // before the next, and no result is emitted twice
+    bool matchable(const AstPtrs& alts) {
+        for (auto& a:alts) {
+            if (a->tag() != AST_EXPR_MATCH) return false;
+            AST_EXPR_MATCH_SPLIT(a, p, mm, g, e);
+            for (auto& m:mm) {
+                if (!matchable_pattern(m)) return false;
+            }
+        }
+        return true;
+    }
+
+    bool matchable_pattern(const AstPtr& a) {
+        switch (a->tag()) {
+        case AST_EXPR_VARIABLE:
+        case AST_EXPR_INTEGER:
+        case AST_EXPR_FLOAT:
+        case AST_EXPR_CHARACTER:
+        case AST_EXPR_TEXT:
+        case AST_EXPR_COMBINATOR:
+        case AST_EXPR_OPERATOR:
+            return true;
+        case AST_EXPR_TAG: {
+            AST_EXPR_TAG_SPLIT(a, p, v, t);
+            return (v->tag() == AST_EXPR_VARIABLE) && (t->tag() == AST_EXPR_COMBINATOR);
+            }
+        case AST_EXPR_APPLICATION: {
+            AST_EXPR_APPLICATION_SPLIT(a, p, aa);
+            if (aa.empty()) return false;
+            for (auto& a0:aa) {
+                if (!matchable_pattern(a0)) return false;
+            }
+            return true;
+            }
+        default:
+            return false;
+        }
+    }
+
+    match_class_t match_class(const AstPtr& a) {
+        switch (a->tag()) {
+        case AST_EXPR_VARIABLE:
+            return MATCH_VARIABLE;
+        case AST_EXPR_TAG:
+            return MATCH_TAG;
+        default:
+            return MATCH_CONSTRUCTOR;
+        }
+    }
+
+    // constructors are told apart by the size of the split, or by the 
+    // constant or tag tested against
+    MatchKey match_key(const AstPtr& a) {
+        switch (a->tag()) {
+        case AST_EXPR_INTEGER: {
+            AST_EXPR_INTEGER_SPLIT(a, p, v);
+            return MatchKey(false, data_integer(v));
+            }
+        case AST_EXPR_FLOAT: {
+            AST_EXPR_FLOAT_SPLIT(a, p, v);
+            return MatchKey(false, data_float(v));
+            }
+        case AST_EXPR_CHARACTER: {
+            AST_EXPR_CHARACTER_SPLIT(a, p, v);
+            return MatchKey(false, data_character(v));
+            }
+        case AST_EXPR_TEXT: {
+            AST_EXPR_TEXT_SPLIT(a, p, v);
+            return MatchKey(false, data_text(v));
+            }
+        case AST_EXPR_COMBINATOR: {
+            AST_EXPR_COMBINATOR_SPLIT(a, p, nn, n);
+            return MatchKey(false, data_combinator(nn, n));
+            }
+        case AST_EXPR_OPERATOR: {
+            AST_EXPR_OPERATOR_SPLIT(a, p, nn, n);
+            return MatchKey(false, data_combinator(nn, n));
+            }
+        case AST_EXPR_TAG: {
+            AST_EXPR_TAG_SPLIT(a, p, v, t);
+            return match_key(t);
+            }
+        case AST_EXPR_APPLICATION: {
+            AST_EXPR_APPLICATION_SPLIT(a, p, aa);
+            return MatchKey(true, aa.size());
+            }
+        default:
+            PANIC("constructor expected");
+            return MatchKey(false, 0);
+        }
+    }
+
+    void match_bind(MatchRow& row, const AstPtr& a, const reg_t r) {
+        if (a->tag() == AST_EXPR_VARIABLE) {
+            AST_EXPR_VARIABLE_SPLIT(a, p, v);
+            row.bindings[v] = r;
+        } else if (a->tag() == AST_EXPR_TAG) {
+            AST_EXPR_TAG_SPLIT(a, p, v, t);
+            match_bind(row, v, r);
+        }
+    }
+
+    void emit_match_block(const AstPtrs& alts, const link_registers_t& links) {
+        auto member = get_coder()->peek_register();
+        auto frame  = get_register_frame();
+
+        uint_t n = 0;
+        while (n < alts.size()) {
+            auto a = alts[n];
+            AST_EXPR_MATCH_SPLIT(a, p, mm, g, e);
+            uint_t arity = mm.size();
+
+            MatchRows rows;
+            while (n < alts.size()) {
+                auto a0 = alts[n];
+                AST_EXPR_MATCH_SPLIT(a0, p0, mm0, g0, e0);
+                if (mm0.size() != arity) break;
+                rows.push_back(MatchRow{mm0, RegisterMap(), e0});
+                n++;
+            }
+
+            auto l = get_coder()->generate_label();
+            set_fail_label(l);
+            set_arity(arity);
+
+            MatchColumns cc;
+            for (uint_t i = 0; i < arity; i++) {
+                cc.push_back(get_coder()->generate_register());
+            }
+            if (arity > 0) {
+                get_coder()->emit_op_takex(cc.front(), cc.back(), frame, 5);
+                get_coder()->emit_op_fail(l);
+            }
+
+            _arguments = cc;
+            emit_match_rows(rows, cc, l, links);
+            _arguments.clear();
+
+            get_coder()->emit_label(l);
+            get_coder()->restore_register(member);
+        }
+    }
+
+    // match the rows against the columns, jump to l when none matches
+    void emit_match_rows(MatchRows& rows, const MatchColumns& cc, const label_t l, 
+                         const link_registers_t& links) {
+        auto& row = rows.front();
+        uint_t c = 0;
+        while (c < cc.size() && match_class(row.patterns[c]) == MATCH_VARIABLE) c++;
+
+        if (c == cc.size()) {
+            for (uint_t i = 0; i < cc.size(); i++) {
+                match_bind(row, row.patterns[i], cc[i]);
+            }
+            emit_match_result(row, links);
+            return;
+        }
+
+        MatchColumns cc0 = cc;
+        cc0.erase(cc0.begin() + c);
+
+        uint_t n = 0;
+        while (n < rows.size()) {
+            auto k = match_class(rows[n].patterns[c]);
+            MatchRows block;
+            while (n < rows.size() && match_class(rows[n].patterns[c]) == k) {
+                block.push_back(rows[n]);
+                n++;
+            }
+
+            bool last = (n == rows.size());
+            auto l0 = last ? l : get_coder()->generate_label();
+
+            if (k == MATCH_VARIABLE) {
+                for (auto& r:block) {
+                    match_bind(r, r.patterns[c], cc[c]);
+                    r.patterns.erase(r.patterns.begin() + c);
+                }
+                emit_match_rows(block, cc0, l0, links);
+            } else {
+                emit_match_switch(block, cc, c, l0, links);
+            }
+
+            if (!last) get_coder()->emit_label(l0);
+        }
+    }
+
+    // the switch a constant key can be dispatched on, if any, and its
+    // case value
+    bool match_switch_key(const MatchKey& key, const bool tagged, switch_kind_t& kind, int64_t& value) {
+        if (key.first) return false;
+        auto o = get_machine()->get_data(key.second);
+        if (tagged) {
+            kind  = SWITCH_TAG;
+            value = o->symbol();
+            return true;
+        }
+        switch (o->tag()) {
+        case VM_OBJECT_INTEGER:
+            kind  = SWITCH_INTEGER;
+            value = VM_OBJECT_INTEGER_VALUE(o);
+            return true;
+        case VM_OBJECT_CHAR:
+            kind  = SWITCH_CHAR;
+            value = VM_OBJECT_CHAR_VALUE(o);
+            return true;
+        case VM_OBJECT_COMBINATOR:
+            kind  = SWITCH_SYMBOL;
+            value = o->symbol();
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // test column c against every constructor in the rows, the 
+    // constructors exclude each other so all rows failing go to l. 
+    // three or more constants of one kind are dispatched with a switch, 
+    // the other constructors are tested in turn
+    void emit_match_switch(MatchRows& rows, const MatchColumns& cc, const uint_t c, const label_t l,
+                           const link_registers_t& links) {
+        std::vector<MatchKey> keys;
+        for (auto& r:rows) {
+            auto k = match_key(r.patterns[c]);
+            if (std::find(keys.begin(), keys.end(), k) == keys.end()) keys.push_back(k);
+        }
+
+        bool tagged = (match_class(rows.front().patterns[c]) == MATCH_TAG);
+        std::map<switch_kind_t, std::vector<std::pair<MatchKey, int64_t>>> kinds;
+        for (auto& key:keys) {
+            switch_kind_t kind;
+            int64_t value;
+            if (match_switch_key(key, tagged, kind, value)) {
+                kinds[kind].push_back(std::make_pair(key, value));
+            }
+        }
+
+        auto switched = kinds.end();
+        for (auto it = kinds.begin(); it != kinds.end(); it++) {
+            if (it->second.size() >= 3 && 
+                (switched == kinds.end() || it->second.size() > switched->second.size())) {
+                switched = it;
+            }
+        }
+
+        auto col = cc[c];
+        if (switched != kinds.end()) {
+            std::vector<MatchKey> tested;
+            for (auto& key:keys) {
+                bool found = false;
+                for (auto& k:switched->second) found = found || (k.first == key);
+                if (!found) tested.push_back(key);
+            }
+            keys = tested;
+
+            SwitchCases cases;
+            for (auto& k:switched->second) {
+                cases.push_back(std::make_pair(k.second, get_coder()->generate_label()));
+            }
+            auto l0 = keys.empty() ? l : get_coder()->generate_label();
+            get_coder()->emit_op_switch(col, switched->first, cases, l0);
+
+            for (uint_t i = 0; i < cases.size(); i++) {
+                get_coder()->emit_label(cases[i].second);
+                auto member = get_coder()->peek_register();
+
+                MatchRows rows0;
+                for (auto& r:rows) {
+                    if (match_key(r.patterns[c]) == switched->second[i].first) rows0.push_back(r);
+                }
+                MatchColumns cc0 = cc;
+                cc0.erase(cc0.begin() + c);
+                for (auto& r:rows0) {
+                    match_bind(r, r.patterns[c], col);
+                    r.patterns.erase(r.patterns.begin() + c);
+                }
+                emit_match_rows(rows0, cc0, l, links);
+
+                get_coder()->restore_register(member);
+            }
+
+            if (keys.empty()) return;
+            get_coder()->emit_label(l0);
+        }
+
+        for (uint_t i = 0; i < keys.size(); i++) {
+            auto& key = keys[i];
+            bool last = (i + 1 == keys.size());
+            auto l0 = last ? l : get_coder()->generate_label();
+            auto member = get_coder()->peek_register();
+
+            MatchRows rows0;
+            for (auto& r:rows) {
+                if (match_key(r.patterns[c]) == key) rows0.push_back(r);
+            }
+
+            MatchColumns cc0;
+            if (key.first) {
+                reg_t x = 0, y = 0;
+                for (uint_t j = 0; j < key.second; j++) {
+                    y = get_coder()->generate_register();
+                    if (j == 0) x = y;
+                }
+                get_coder()->emit_op_split(x, y, col);
+                get_coder()->emit_op_fail(l0);
+
+                auto arg = std::find(_arguments.begin(), _arguments.end(), col);
+                if (arg != _arguments.end()) {
+                    index_t slot = 5 + (arg - _arguments.begin());
+                    _cells.push_back(match_cell_t{col, slot, key.second});
+                }
+
+                cc0.insert(cc0.end(), cc.begin(), cc.begin() + c);
+                for (reg_t r = x; r <= y; r++) cc0.push_back(r);
+                cc0.insert(cc0.end(), cc.begin() + c + 1, cc.end());
+                for (auto& r:rows0) {
+                    auto a = r.patterns[c];
+                    AST_EXPR_APPLICATION_SPLIT(a, p, aa);
+                    r.patterns.erase(r.patterns.begin() + c);
+                    r.patterns.insert(r.patterns.begin() + c, aa.begin(), aa.end());
+                }
+            } else {
+                auto rk = get_coder()->generate_register();
+                get_coder()->emit_op_data(rk, key.second);
+                if (tagged) {
+                    get_coder()->emit_op_tag(col, rk);
+                } else {
+                    get_coder()->emit_op_test(col, rk);
+                }
+                get_coder()->emit_op_fail(l0);
+
+                cc0 = cc;
+                cc0.erase(cc0.begin() + c);
+                for (auto& r:rows0) {
+                    match_bind(r, r.patterns[c], col);
+                    r.patterns.erase(r.patterns.begin() + c);
+                }
+            }
+
+            emit_match_rows(rows0, cc0, l, links);
+            if (key.first && !_cells.empty() && _cells.back().r == col) _cells.pop_back();
+
+            get_coder()->restore_register(member);
+            if (!last) get_coder()->emit_label(l0);
+        }
+    }
+
+    void emit_match_result(const MatchRow& row, const link_registers_t& links) {
+        auto member = get_coder()->peek_register();
+
+        for (auto& b:row.bindings) {
+            add_variable_binding(b.first, b.second);
+        }
+
+        set_link_registers(links);
+        set_state(EMIT_EXPR_ROOT);
+        set_tail(false);
+        _reusable = _cells;
+        visit(row.result);
+
+        if (!get_tail()) {
+            auto k = get_register_k();
+            get_coder()->emit_op_return(k);
+        }
+
+        get_coder()->restore_register(member);
+    }
+
     void visit_expr_try(const Position& p, const AstPtr& t, const AstPtr& c) override {
         auto rt  = get_register_rt();
         auto rti = get_register_rti();
@@ -547,6 +1434,7 @@ public:
                     AST_EXPR_COMBINATOR_SPLIT(n, p, ss, s);
                     auto d = VMObjectData(get_machine(), ss, s).clone();
                     get_machine()->define_data(d);
+                    _defined.push_back(d);
                 }
                 break;
             default:
@@ -555,6 +1443,25 @@ public:
         }
     }
 
+    // the least width of the alternatives of a definition, applied to
+    // fewer arguments none of them matches
+    int definition_arity(const AstPtr& e) {
+        if (e->tag() == AST_EXPR_MATCH) {
+            AST_EXPR_MATCH_SPLIT(e, p, mm, g, r);
+            return mm.size();
+        } else if (e->tag() == AST_EXPR_BLOCK) {
+            AST_EXPR_BLOCK_SPLIT(e, p, alts);
+            int a = -1;
+            for (auto& alt:alts) {
+                auto n = definition_arity(alt);
+                if (a < 0 || n < a) a = n;
+            }
+            return (a < 0 ? 0 : a);
+        } else {
+            return 0;
+        }
+    }
+
     void visit_decl_definition(const Position& p, const AstPtr& n, const AstPtr& e) override {
         auto frame = get_coder()->generate_register();
 
@@ -574,6 +1481,9 @@ public:
         set_register_exc(exc);
         set_arity(0);
 
+        AST_EXPR_COMBINATOR_SPLIT(n, p0, ss, s);
+        set_self(get_machine()->enter_symbol(ss, s));
+
         get_coder()->emit_op_takex(rt, c, frame, 0);
         get_coder()->emit_op_fail(l);
         set_state(EMIT_EXPR_ROOT);
@@ -589,11 +1499,11 @@ public:
         get_coder()->emit_op_return(k);
 
         auto code = get_coder()->code();
-        AST_EXPR_COMBINATOR_SPLIT(n, p0, ss, s);
-        auto b = VMObjectBytecode(get_machine(), code, ss, s).clone();
+        auto b = VMObjectBytecode(get_machine(), code, get_coder()->registers(), definition_arity(e), ss, s).clone();
 
         get_coder()->reset();
         get_machine()->define_data(b);
+        _defined.push_back(b);
     }
 
     void visit_decl_operator(const Position& p, const AstPtr& o, const AstPtr& e) override {
@@ -615,6 +1525,9 @@ public:
         set_register_exc(exc);
         set_arity(0);
 
+        AST_EXPR_OPERATOR_SPLIT(o, p0, ss, s);
+        set_self(get_machine()->enter_symbol(ss, s));
+
         get_coder()->emit_op_takex(rt, c, frame, 0);
         get_coder()->emit_op_fail(l);
         set_state(EMIT_EXPR_ROOT);
@@ -630,11 +1543,11 @@ public:
         get_coder()->emit_op_return(k);
 
         auto code = get_coder()->code();
-        AST_EXPR_OPERATOR_SPLIT(o, p0, ss, s);
-        auto b = VMObjectBytecode(get_machine(), code, ss, s).clone();
+        auto b = VMObjectBytecode(get_machine(), code, get_coder()->registers(), definition_arity(e), ss, s).clone();
 
         get_coder()->reset();
         get_machine()->define_data(b);
+        _defined.push_back(b);
     }
 
 private:
@@ -653,10 +1566,22 @@ private:
     label_t         _fail;
     CoderPtr        _coder;
     RegisterMap     _variables;
+
+    symbol_t            _self;
+    symbol_t            _nil;
+    symbol_t            _cons;
+    symbol_t            _tuple;
+    link_registers_t    _entry;
+    bool                _tail;
+
+    MatchColumns        _arguments;
+    MatchCells          _cells;
+    MatchCells          _reusable;
+    VMObjectPtrs        _defined;
 };
 
-void emit_code(VM* m, const AstPtr& a) {
+VMObjectPtrs emit_code(VM* m, const AstPtr& a) {
     EmitCode emit;
-    emit.emit(m, a);
+    return emit.emit(m, a);
 }
 
@@ -9,6 +9,7 @@
 #include "bytecode.hpp"
 
 void emit_data(VM* vm, const AstPtr& a);
-void emit_code(VM* vm, const AstPtr& a);
+// the data and combinators defined, in order
+VMObjectPtrs emit_code(VM* vm, const AstPtr& a);
 
 #endif
@@ -29,6 +29,10 @@ public:
         return "";
     }
 
+    Table symbols() const {
+        return _symbols;
+    }
+
     virtual void render(std::ostream& os, uint_t indent) const = 0;
 
     void skip(std::ostream& os, uint_t indent) const {
@@ -82,6 +86,10 @@ public:
         }
     }
 
+    NamespaceMap embeds() const {
+        return _embeds;
+    }
+
     void render(std::ostream& os, uint_t indent) const override {
         for (auto const& sym:_symbols) {
             skip(os, indent);
@@ -27,7 +27,7 @@ public:
     }
 
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
+        VMFrame tt(thunk);
         auto arg0   = tt[5];
 
         (_callback)(machine(), arg0);
@@ -69,24 +69,10 @@ public:
     }
 
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
-        auto exc = tt[3];
-        // auto c   = tt[4];
+        VMFrame tt(thunk);
 
         // XXX: doesn't handle exceptions yet
-        VMObjectPtrs rr;
-        rr.push_back(rt);
-        rr.push_back(rti);
-        rr.push_back(k);
-        rr.push_back(exc);
-        rr.push_back(_result.result);
-        for (uint i = 5; i < tt.size(); i++) {
-            rr.push_back(tt[i]);
-        }
-        return VMObjectArray(rr).clone();
+        return tt.continuation(_result.result, 5);
     }
 private:
     VMReduceResult _result;
@@ -130,6 +116,14 @@ public:
         mm->load(p, lib);
     }
 
+    // restore from an image when it is fresh, otherwise load and write it
+    void eval_image(const icu::UnicodeString& image, const icu::UnicodeString& lib) {
+        auto mm = get_manager();
+        if (mm->load_image(image, lib)) return;
+        eval_load(lib);
+        mm->save_image(image, lib);
+    }
+
     /*
      * Interactive evaluation.
      *
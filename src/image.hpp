@@ -0,0 +1,92 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include "cache.hpp"
+
+/**
+ * An image is a snapshot of a machine after a program and everything
+ * it imports were loaded: all declarations in the global namespace and
+ * all data and combinators the source modules defined, in one file.
+ *
+ * Restoring an image maps it, loads the dynamic modules such that
+ * their builtins rebind by symbol, and defines everything else without
+ * touching the sources. An image is fresh under the same conditions
+ * as a module cache, for all modules loaded. Images are conventionally
+ * named after the program, 'life.egi' for 'life.eg'.
+ **/
+
+#define IMAGE_MAGIC     "egelimage"
+
+// a loaded module, source modules defined a number of objects
+typedef struct {
+    bool                dynamic;
+    icu::UnicodeString  path;
+    icu::UnicodeString  filename;
+    uint32_t            definitions;
+} image_module_t;
+
+typedef std::vector<image_module_t> ImageModules;
+
+class Image: public Cache {
+public:
+    Image() {
+    }
+
+    icu::UnicodeString program() const {
+        return _program;
+    }
+
+    void set_program(const icu::UnicodeString& fn) {
+        _program = fn;
+    }
+
+    ImageModules modules() const {
+        return _modules;
+    }
+
+    void add_module(const image_module_t& m) {
+        _modules.push_back(m);
+    }
+
+    bool save(const icu::UnicodeString& path) const {
+        CacheWriter w;
+        cache_write_header(w, IMAGE_MAGIC);
+        cache_write_dependencies(w, dependencies());
+        w.text(_program);
+        w.i32(_modules.size());
+        for (auto& m:_modules) {
+            w.u8(m.dynamic);
+            w.text(m.path);
+            w.text(m.filename);
+            w.i32(m.definitions);
+        }
+        write(w);
+        return w.save(path);
+    }
+
+    // load a fresh image, false if there is none
+    bool load(const icu::UnicodeString& path) {
+        CacheReader r;
+        if (!r.load(path)) return false;
+        if (!cache_read_header(r, IMAGE_MAGIC)) return false;
+        CacheDependencies dd;
+        if (!cache_read_dependencies(r, dd)) return false;
+        _program = r.text();
+        uint32_t n = r.i32();
+        for (uint32_t i = 0; i < n && r.good(); i++) {
+            image_module_t m;
+            m.dynamic = r.u8();
+            m.path = r.text();
+            m.filename = r.text();
+            m.definitions = r.i32();
+            _modules.push_back(m);
+        }
+        return read(r) && r.done();
+    }
+
+private:
+    icu::UnicodeString  _program;
+    ImageModules        _modules;
+};
+
+#endif
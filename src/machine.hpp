@@ -4,12 +4,18 @@
 #include <memory>
 #include <sstream>
 #include <vector>
+#include <deque>
 #include <map>
 #include <set>
 #include <iomanip>
 #include <tuple>
+#include <fstream>
+#include <algorithm>
+#include <signal.h>
+#include <sys/time.h>
 
 #include "runtime.hpp"
+#include "bytecode.hpp"
 
 class SymbolTable {
 public:
@@ -84,7 +90,7 @@ private:
 class DataTable {
 public:
     DataTable():
-            _to(std::vector<VMObjectPtr>()) {
+            _to(std::deque<VMObjectPtr>()) {
            // _from(std::map<VMObjectPtr, data_t, LessVMObjectPtr>()) {
     }
 
@@ -95,10 +101,13 @@ public:
     void initialize() {
     }
 
+    // data lives as long as the machine, entries are pinned such that 
+    // handing them out costs no reference counting. a redefined entry
+    // is leaked.
     data_t enter(const VMObjectPtr& s) {
         if (_from.count(s) == 0) {
             data_t n = _to.size();
-            _to.push_back(s);
+            _to.push_back(VMObjectPtr::pin(s));
             _from[s] = n;
             return n;
         } else {
@@ -111,7 +120,7 @@ public:
             return enter(s);
         } else {
             data_t n = _from[s];
-            _to[n] = s;
+            _to[n] = VMObjectPtr::pin(s);
             return n;
         }
     }
@@ -120,16 +129,25 @@ public:
         return _to[s];
     }
 
+    // slots don't move, the table only grows at the end
+    const VMObjectPtr* slot(const data_t& s) {
+        return &_to[s];
+    }
+
     void render(std::ostream& os) {
         for (uint_t t = 0; t < _to.size(); t++) {
             os << std::setw(8) << t << ":";
-            _to[t]->debug(os);
+            if (_to[t].is_immediate()) {
+                os << _to[t];
+            } else {
+                _to[t]->debug(os);
+            }
             os << std::endl;
         }
     }
             
 private:
-    std::vector<VMObjectPtr>                        _to;
+    std::deque<VMObjectPtr>                         _to;
     std::map<VMObjectPtr, data_t, LessVMObjectPtr>  _from;
 };
 
@@ -148,7 +166,7 @@ public:
     }
 
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
+        VMFrame tt(thunk);
         auto arg0   = tt[5];
 
         _result->result    = arg0;
@@ -161,6 +179,140 @@ private:
     bool            _exception;
 };
 
+/**
+ * A sampling profiler for Egel code.
+ *
+ * A profiling timer raises a flag every millisecond of cpu time, the 
+ * trampoline then samples the combinator it is about to reduce together
+ * with the combinators of the continuations it returns to. That chain
+ * is the Egel call stack; it is cut off at a depth of frames, deep
+ * recursion shows as its innermost calls.
+ *
+ * The report gives a flat profile and the call edges, and writes the 
+ * stacks in the folded format flame graph tools read.
+ **/
+class Profiler {
+public:
+    static const size_t DEPTH    = 64;
+    static const long   INTERVAL = 1000; // microseconds
+
+    static void start() {
+        struct sigaction sa = {};
+        sa.sa_handler = [](int) { _due.store(true, std::memory_order_relaxed); };
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGPROF, &sa, nullptr);
+        timer(INTERVAL);
+    }
+
+    static void stop() {
+        timer(0);
+    }
+
+    static bool due() {
+        return _due.load(std::memory_order_relaxed);
+    }
+
+    // a raw pointer, such that the trampoline can stay in a register
+    VM_NOINLINE static void sample(const VMObject* thunk) {
+        _due.store(false, std::memory_order_relaxed);
+
+        // frames are counted, not symbols, or a chain of literals is walked to its end
+        Stack ss;
+        auto t = thunk;
+        for (size_t d = 0; (t != nullptr) && (t->tag() == VM_OBJECT_ARRAY) && (d < DEPTH); d++) {
+            auto& tt = *static_cast<const VMObjectArray*>(t);
+            if ((tt.size() < 5) || (tt[4] == nullptr)) break;
+            // literals returning themselves are charged to their caller
+            auto c = tt[4]->tag();
+            if ((c == VM_OBJECT_COMBINATOR) || (c == VM_OBJECT_ARRAY)) {
+                ss.push_back(tt[4]->symbol());
+            }
+            t = tt[2].counted();
+        }
+
+        std::lock_guard<std::mutex> lock(state().lock);
+        state().stacks[ss]++;
+    }
+
+    static void report(VM* m, std::ostream& os, std::ostream& folded) {
+        auto& st = state();
+        std::lock_guard<std::mutex> lock(st.lock);
+
+        uint64_t total = 0;
+        std::map<symbol_t, uint64_t> self;
+        std::map<symbol_t, uint64_t> inclusive;
+        std::map<std::pair<symbol_t, symbol_t>, uint64_t> edges;
+        for (auto& s:st.stacks) {
+            auto& ss = s.first;
+            auto  n  = s.second;
+            total += n;
+            if (ss.empty()) continue;
+            self[ss[0]] += n;
+            // recursion counts a combinator, or a call, once per sample
+            std::set<symbol_t> seen(ss.begin(), ss.end());
+            for (auto c:seen) inclusive[c] += n;
+            std::set<std::pair<symbol_t, symbol_t>> called;
+            for (size_t i = 0; i + 1 < ss.size(); i++) called.insert({ss[i+1], ss[i]});
+            for (auto& c:called) edges[c] += n;
+
+            // outermost first, as flame graph tools want it
+            for (size_t i = ss.size(); i-- > 0; ) {
+                folded << m->get_symbol(ss[i]) << (i > 0 ? ";" : " ");
+            }
+            folded << n << std::endl;
+        }
+
+        auto percentage = [total](uint64_t n) {
+            return (total == 0) ? 0.0 : (100.0 * n) / total;
+        };
+
+        os << "profile: " << total << " samples" << std::endl;
+        std::vector<std::pair<uint64_t, symbol_t>> flat;
+        for (auto& i:inclusive) flat.push_back({self[i.first], i.first});
+        std::sort(flat.rbegin(), flat.rend());
+        os << std::fixed << std::setprecision(1);
+        os << std::setw(8) << "self%" << std::setw(8) << "total%" << "  combinator" << std::endl;
+        for (auto& f:flat) {
+            os << std::setw(8) << percentage(f.first) << std::setw(8) << percentage(inclusive[f.second]) 
+               << "  " << m->get_symbol(f.second) << std::endl;
+        }
+
+        os << "calls:" << std::endl;
+        std::vector<std::pair<uint64_t, std::pair<symbol_t, symbol_t>>> ee;
+        for (auto& e:edges) ee.push_back({e.second, e.first});
+        std::sort(ee.rbegin(), ee.rend());
+        for (auto& e:ee) {
+            os << std::setw(8) << percentage(e.first) << "  " << m->get_symbol(e.second.first) 
+               << " -> " << m->get_symbol(e.second.second) << std::endl;
+        }
+        os << std::defaultfloat;
+    }
+
+private:
+    typedef std::vector<symbol_t> Stack;
+
+    struct State {
+        std::mutex                  lock;
+        std::map<Stack, uint64_t>   stacks;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+
+    static void timer(long usec) {
+        struct itimerval it;
+        it.it_interval.tv_sec  = 0;
+        it.it_interval.tv_usec = usec;
+        it.it_value = it.it_interval;
+        setitimer(ITIMER_PROF, &it, nullptr);
+    }
+
+    static inline std::atomic<bool> _due{false};
+};
+
 class Machine: public VM {
 public:
     Machine() {
@@ -206,6 +358,10 @@ public:
         return _data.get(d);
     }
 
+    const VMObjectPtr* get_data_slot(const data_t d) override {
+        return _data.slot(d);
+    }
+
     // reduce an expression
     void reduce(const VMObjectPtr& f, const VMObjectPtr& ret, const VMObjectPtr& exc) override {
         VMObjectPtrs rr;
@@ -215,7 +371,7 @@ public:
         rr.push_back(nullptr); // exc
         rr.push_back(ret); // c
         rr.push_back(nullptr); // arg0
-        auto r = VMObjectArray(rr).clone();
+        auto r = VMObjectArray::create(rr);
 
         VMObjectPtrs ee;
         ee.push_back(nullptr); // rt
@@ -224,7 +380,7 @@ public:
         ee.push_back(nullptr); // exc
         ee.push_back(exc); // c
         ee.push_back(nullptr); // arg0
-        auto e = VMObjectArray(ee).clone();
+        auto e = VMObjectArray::create(ee);
 
         auto i = VMObjectInteger(5).clone();
         VMObjectPtrs tt;
@@ -233,18 +389,25 @@ public:
         tt.push_back(r); // k
         tt.push_back(e); // exc
         tt.push_back(f); // c
-        auto t = VMObjectArray(tt).clone();
+        auto t = VMObjectArray::create(tt);
 
         auto trampoline = t;
+        uint64_t iterations = 0;
         while (trampoline != nullptr) {
+            iterations++;
             ASSERT(trampoline->tag() == VM_OBJECT_ARRAY);
-            auto f = VM_OBJECT_ARRAY_CAST(trampoline)->get(4);
+            // trampoline keeps the thunk, and so its combinator, alive until reduce returns
+            const auto& f = VM_OBJECT_ARRAY_REF(trampoline)[4];
 #ifdef DEBUG
             std::cout << "trace: " << f << std::endl;
             std::cout << "on : " << trampoline << std::endl;
 #endif
+            if (Profiler::due()) Profiler::sample(trampoline.get());
             trampoline = f->reduce(trampoline);
+            if (vm_object_tracing) VMObjectCollector::poll();
         }
+        VMObjectReaper::drain();
+        if (vm_statistics) VMStatistics::trampolined(iterations);
     }
 
     VMReduceResult reduce(const VMObjectPtr& f) override {
@@ -267,6 +430,37 @@ public:
     void release_lock() override {
     }
                     
+    Statistics statistics() override {
+        static constexpr const char* tags[] = {
+            "integer", "float", "char", "text", "pointer", "opaque", "combinator", "array",
+        };
+        static_assert(sizeof(tags) / sizeof(char*) == VMStatistics::TAGS, "tag missing");
+
+        Statistics ss;
+        for (size_t t = 0; t < VMStatistics::TAGS; t++) {
+            auto tag = static_cast<vm_object_tag_t>(t);
+            ss.push_back({ icu::UnicodeString("objects.") + tags[t], VMStatistics::objects(tag) });
+            ss.push_back({ icu::UnicodeString("bytes.") + tags[t], VMStatistics::bytes(tag) });
+        }
+        ss.push_back({ "objects.live", VMStatistics::live() });
+        ss.push_back({ "objects.peak", VMStatistics::peak() });
+        ss.push_back({ "trampoline.iterations", VMStatistics::iterations() });
+        for (int op = 0; op <= OP_RETURN; op++) {
+            auto n = VMStatistics::instructions(op);
+            auto o = static_cast<opcode_t>(op);
+            ss.push_back({ icu::UnicodeString("instructions.") + Disassembler::opcode_to_text(o), n });
+        }
+        ss.push_back({ "builtin.applies", VMStatistics::applies() });
+        ss.push_back({ "builtin.nanoseconds", VMStatistics::apply_time() });
+        if (vm_object_tracing) {
+            auto gc = VMObjectCollector::statistics();
+            ss.push_back({ "collector.collections", gc.collections });
+            ss.push_back({ "collector.candidates", gc.candidates });
+            ss.push_back({ "collector.freed", gc.freed });
+        }
+        return ss;
+    }
+
     void render(std::ostream& os) override {
         os << "SYMBOLS: " << std::endl;
         _symbols.render(os);
@@ -2,6 +2,7 @@
 #define MODULES_HPP
 
 #include <vector>
+#include <map>
 
 #include "error.hpp"
 #include "ast.hpp"
@@ -13,6 +14,7 @@
 #include "lift.hpp"
 #include "runtime.hpp"
 #include "emit.hpp"
+#include "image.hpp"
 
 #include "builtin/system.hpp"
 #include "builtin/math.hpp"
@@ -143,6 +145,12 @@ public:
         _bytecode_flag = f;
     }
 
+    // whether a compiler pass is to be shown
+    bool debugging() const {
+        return _tokenize_flag || _unparse_flag || _semantical_flag ||
+               _desugar_flag || _lift_flag || _bytecode_flag;
+    }
+
     bool only_bytecode() const {
         return _bytecode_flag;
     }
@@ -265,6 +273,18 @@ public:
 
     virtual VMObjectPtrs exports() = 0;
 
+    // the qualified names the module declares, and what they are
+    virtual CacheReferences declared() {
+        CacheReferences rr;
+        for (auto& o:exports()) {
+            if (o->tag() == VM_OBJECT_COMBINATOR) {
+                auto s = machine()->get_symbol(VM_OBJECT_COMBINATOR_SYMBOL(o));
+                rr.push_back(cache_reference(s, o));
+            }
+        }
+        return rr;
+    }
+
     virtual void render(std::ostream& os) const = 0;
 
     friend std::ostream& operator<<(std::ostream& os, const ModulePtr& m) {
@@ -482,12 +502,13 @@ class ModuleSource : public Module {
 public:
     ModuleSource(const icu::UnicodeString& path, const icu::UnicodeString& fn, VM* m):
         Module(MODULE_SOURCE, path, fn, m),
-        _source(""), _ast(0) {
+        _source(""), _ast(0), _cache(nullptr), _cached(false) {
     }
 
     ModuleSource(const ModuleSource& m):
         Module(MODULE_SOURCE, m.get_path(), m.get_filename(), m.machine()),
-        _source(m._source), _ast(m._ast) {
+        _source(m._source), _ast(m._ast), _imports(m._imports),
+        _cache(m._cache), _cached(m._cached), _defined(m._defined) {
         set_options(m.get_options());
     }
 
@@ -507,22 +528,58 @@ public:
     }
 
     Imports imports() override {
-        auto aa = ::imports(_ast);
-        auto ii = Imports();
-        for (auto a:aa) {
-            if (a->tag() == AST_DIRECT_IMPORT) {
-                AST_DIRECT_IMPORT_SPLIT(a, p, s);
-                ii.push_back(Import(p, unicode_strip_quotes(s)));
-            }
-        }
-        return ii;        
+        return _imports;
     }
 
     VMObjectPtrs exports() override {
-        return VMObjectPtrs(); // XXX XXX XXX: implement this
+        return _defined;
+    }
+
+    // what source defines is only known once it is compiled
+    CacheReferences declared() override {
+        if (_cached && _cache != nullptr) return _cache->defined();
+        CacheReferences rr;
+        for (auto& d: ::declarations(_ast)) {
+            rr.push_back(cache_reference_t{d.qualified, CACHE_UNKNOWN, 0});
+        }
+        return rr;
     }
 
     void syntactical() override {
+        if (!get_options()->debugging()) {
+            _cache = CachePtr(new Cache());
+            if (_cache->load(cache_path(get_path()))) {
+                _cached = true;
+                _source = "";
+                _imports = Imports();
+                for (auto& i:_cache->imports()) {
+                    _imports.push_back(Import(Position(get_filename(), i.row, i.column), i.filename));
+                }
+                return;
+            }
+            _cache = CachePtr(new Cache());
+        }
+        syntactical_source();
+    }
+
+    // a cache referring to a name which isn't declared, or not as what
+    // it was, is dropped and the source is compiled instead. true if so
+    bool recheck(const std::map<icu::UnicodeString, cache_reference_t>& declared) {
+        if (!_cached || _cache == nullptr) return false;
+        for (auto& r:_cache->references()) {
+            auto i = declared.find(r.name);
+            if (i == declared.end() || !cache_reference_same(i->second, r)) {
+                _cached = false;
+                _cache = CachePtr(new Cache());
+                load();
+                syntactical_source();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void syntactical_source() {
         StringCharReader r = StringCharReader(get_filename(), _source);
         TokenReaderPtr tt = tokenize_from_reader(r);
 
@@ -544,13 +601,43 @@ public:
 
         _source = "";
         _ast = a;
+
+        _imports = Imports();
+        for (auto a: ::imports(_ast)) {
+            if (a->tag() == AST_DIRECT_IMPORT) {
+                AST_DIRECT_IMPORT_SPLIT(a, p, s);
+                _imports.push_back(Import(p, unicode_strip_quotes(s)));
+            }
+        }
+
+        if (_cache != nullptr) {
+            CacheImports cc;
+            for (auto& i:_imports) {
+                cc.push_back(cache_import_t{i.position().row(), i.position().column(), i.filename()});
+            }
+            _cache->set_imports(cc);
+        }
 	}
 
     void declarations(NamespacePtr& env) override {
-        declare(env, _ast);
+        if (_cached) {
+            // a cache holds positions without the file name
+            auto dd = _cache->declarations();
+            for (auto& d:dd) {
+                d.position = Position(get_filename(), d.position.row(), d.position.column());
+            }
+            declare(env, dd);
+        } else if (_cache != nullptr) {
+            auto dd = ::declarations(_ast);
+            _cache->set_declarations(dd);
+            declare(env, dd);
+        } else {
+            declare(env, _ast);
+        }
 	}
 
     void semantical(NamespacePtr& env) override {
+        if (_cached) return;
         _ast = ::identify(env, _ast);
 
         if (get_options()->only_semantical()) {
@@ -563,6 +650,7 @@ public:
 	}
 
     void desugar() override {
+        if (_cached) return;
          _ast = ::desugar(_ast);
         if (get_options()->only_desugar()) {
             std::cout << _ast << std::endl;
@@ -572,6 +660,7 @@ public:
 	}
 
     void lift() override {
+        if (_cached) return;
          _ast = ::lift(_ast);
 
         if (get_options()->only_lift()) {
@@ -581,11 +670,19 @@ public:
 	}
 
     void datagen(VM* vm) override {
-        ::emit_data(vm, _ast);
+        if (_cached) {
+            _cache->define_data(vm);
+        } else {
+            ::emit_data(vm, _ast);
+        }
 	}
 
     void codegen(VM* vm) override {
-        ::emit_code(vm, _ast);
+        if (_cached) {
+            _defined = _cache->define_code(vm);
+        } else {
+            _defined = ::emit_code(vm, _ast);
+        }
         if (get_options()->only_bytecode()) {
             vm->render(std::cout);
             exit (EXIT_SUCCESS);
@@ -600,9 +697,30 @@ public:
         return unicode_endswith(fn, ".eg");
     }
 
+    // a module restored from an image
+    void restore(const VMObjectPtrs& oo) {
+        _cached = true;
+        _source = "";
+        _defined = oo;
+    }
+
+    // write the cache of a freshly compiled module, failures are ignored
+    void cache(const UnicodeStrings& dependencies) {
+        if (_cached || _cache == nullptr) return;
+        _cache->set_dependencies(dependencies);
+        if (_cache->set_definitions(machine(), _defined)) {
+            _cache->save(cache_path(get_path()));
+        }
+        _cache = nullptr;
+    }
+
 private:
     icu::UnicodeString   _source;
     AstPtr          _ast;
+    Imports         _imports;
+    CachePtr        _cache;
+    bool            _cached;
+    VMObjectPtrs    _defined;
 };
 
 typedef std::vector<ModulePtr> ModulePtrs;
@@ -668,11 +786,68 @@ public:
         preload(p, fn);
         _loading[0]->set_options(_options);
         transitive_closure();
+        recheck();
          reverse(); // XXX: why was this again?
         process();
         flush();
     }
 
+    // restore the program from a fresh image, false if there is none
+    bool load_image(const icu::UnicodeString& path, const icu::UnicodeString& fn) {
+        Image i;
+        if (!i.load(path) || i.program() != fn) return false;
+
+        for (auto& m:i.modules()) {
+            if (m.dynamic) {
+                auto d = ModuleDynamic(m.path, m.filename, _machine).clone();
+                d->set_options(Options().clone());
+                d->load();
+                _loading.push_back(d);
+            }
+        }
+        process();
+        flush();
+
+        declare(_environment, i.declarations());
+        i.define_data(_machine);
+        auto oo = i.define_code(_machine);
+
+        auto o = oo.begin();
+        for (auto& m:i.modules()) {
+            if (!m.dynamic) {
+                auto s = ModuleSource(m.path, m.filename, _machine).clone();
+                std::static_pointer_cast<ModuleSource>(s)->restore(VMObjectPtrs(o, o + m.definitions));
+                o += m.definitions;
+                _modules.push_back(s);
+            }
+        }
+        return true;
+    }
+
+    // write an image of all that is loaded, failures are ignored
+    void save_image(const icu::UnicodeString& path, const icu::UnicodeString& fn) {
+        Image i;
+        UnicodeStrings pp;
+        VMObjectPtrs oo;
+        for (auto& m:_modules) {
+            if (m->tag() == MODULE_SOURCE) {
+                auto dd = m->exports();
+                i.add_module(image_module_t{false, m->get_path(), m->get_filename(), (uint32_t) dd.size()});
+                oo.insert(oo.end(), dd.begin(), dd.end());
+                pp.push_back(m->get_path());
+            } else if (m->tag() == MODULE_DYNAMIC) {
+                i.add_module(image_module_t{true, m->get_path(), m->get_filename(), 0});
+                pp.push_back(m->get_path());
+            }
+        }
+        i.set_program(fn);
+        i.set_dependencies(pp);
+        i.set_declarations(::declarations(_environment));
+        if (i.set_definitions(_machine, oo)) {
+            i.save(path);
+        }
+    }
+
     friend std::ostream& operator<<(std::ostream& os, const ModuleManager& mm) {
         for (auto m:mm._modules) {
             os << m << std::endl;
@@ -743,6 +918,31 @@ protected:
         }
     }
 
+    // caches are checked against the names declared before and by all
+    // modules being loaded, before anything is declared. a dropped cache
+    // makes what its module defines unknown, so check again
+    void recheck() {
+        std::map<icu::UnicodeString, cache_reference_t> defined;
+        for (auto& d: ::declarations(_environment)) {
+            defined[d.qualified] = cache_reference(d.qualified, _machine->get_data_string(d.qualified));
+        }
+        bool dropped = true;
+        while (dropped) {
+            auto declared = defined;
+            for (auto& m:_loading) {
+                for (auto& r:m->declared()) {
+                    declared[r.name] = r;
+                }
+            }
+            dropped = false;
+            for (auto& m:_loading) {
+                if (m->tag() == MODULE_SOURCE) {
+                    dropped = std::static_pointer_cast<ModuleSource>(m)->recheck(declared) || dropped;
+                }
+            }
+        }
+    }
+
     void reverse() {
         ModulePtrs ll;
         for (int i = _loading.size() - 1; i >= 0; i--) {
@@ -770,6 +970,41 @@ protected:
         for (auto& m:_loading) {
             m->codegen(_machine);
         }
+        for (auto& m:_loading) {
+            if (m->tag() == MODULE_SOURCE) {
+                std::static_pointer_cast<ModuleSource>(m)->cache(dependencies(m));
+            }
+        }
+    }
+
+    ModulePtr lookup(const icu::UnicodeString& path) {
+        for (auto& m:_modules) {
+            if (m->get_path().compare(path) == 0) return m;
+        }
+        for (auto& m:_loading) {
+            if (m->get_path().compare(path) == 0) return m;
+        }
+        return nullptr;
+    }
+
+    // the paths of a module and all it imports, directly or indirectly
+    UnicodeStrings dependencies(const ModulePtr& m) {
+        UnicodeStrings pp;
+        pp.push_back(m->get_path());
+        uint_t n = 0;
+        while (n < pp.size()) {
+            auto m0 = lookup(pp[n]);
+            if (m0 != nullptr) {
+                for (auto& i:m0->imports()) {
+                    auto p = search(get_options()->get_include_path(), i.filename());
+                    if (std::find(pp.begin(), pp.end(), p) == pp.end()) {
+                        pp.push_back(p);
+                    }
+                }
+            }
+            n++;
+        }
+        return pp;
     }
 
     void flush() {
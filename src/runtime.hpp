@@ -14,6 +14,28 @@
 #include <vector>
 #include <set>
 #include <limits>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <chrono>
+
+#if defined(__has_include)
+#if __has_include(<sys/single_threaded.h>)
+#include <sys/single_threaded.h>
+#define VM_SINGLE_THREADED  __libc_single_threaded
+#endif
+#endif
+#ifndef VM_SINGLE_THREADED
+#define VM_SINGLE_THREADED  false
+#endif
+
+#if defined(__GNUC__)
+#define VM_NOINLINE __attribute__((noinline))
+#define VM_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+#define VM_NOINLINE
+#define VM_CONSTANT_EVALUATED() false
+#endif
 
 #include "unicode/unistr.h"
 #include "unicode/ustdio.h"
@@ -109,6 +131,8 @@ typedef void*           vm_ptr_t;
 #define SYMBOL_TRUE     6
 #define SYMBOL_FALSE    7
 
+#define SYMBOL_PREDEFINED   (SYMBOL_FALSE + 1)
+
 typedef uint32_t    symbol_t;
 typedef uint32_t    data_t;
 
@@ -122,28 +146,593 @@ typedef enum {
     VM_OBJECT_FLAG_STUB       = (1 << 6),
 } vm_object_flag_t;
 
+/**
+ * VM objects are allocated from size-class pools.
+ *
+ * Blocks are carved from large chunks which are never given back to the
+ * system. That makes every block of a size class interchangeable; a block
+ * may be released on another thread, or by another dynamically loaded
+ * module, than the one which allocated it.
+ *
+ * Every thread keeps a free list per size class of at most LIMIT blocks.
+ * A list which overflows spills half of its blocks to a shared depot, a
+ * list which runs dry draws a batch from the depot before carving a new
+ * chunk. The lists of an exiting thread are handed to the depot.
+ **/
+class VMObjectPool {
+public:
+    static const size_t GRANULE = 16;
+    static const size_t CLASSES = 16;         // pooled blocks up to 256 bytes
+    static const size_t CHUNK   = 64 * 1024;
+    static const size_t LIMIT   = CHUNK / GRANULE; // a chunk always fits
+    static const size_t BATCH   = LIMIT / 2;
+
+    static void* allocate(size_t sz) {
+        size_t c = size_class(sz);
+        if (c >= CLASSES) return ::operator new(sz);
+        auto& cc = cache();
+        if (cc.free[c] == nullptr) refill(c);
+        auto b = cc.free[c];
+        cc.free[c] = b->next;
+        cc.count[c]--;
+        return b;
+    }
+
+    static void release(void* p, size_t sz) {
+        size_t c = size_class(sz);
+        if (c >= CLASSES) {
+            ::operator delete(p);
+            return;
+        }
+        auto b = static_cast<Block*>(p);
+        auto& cc = cache();
+        if (cc.free[c] == nullptr) enlist();
+        b->next = cc.free[c];
+        cc.free[c] = b;
+        if (++cc.count[c] > LIMIT) spill(c);
+    }
+
+private:
+    struct Block {
+        Block*  next;
+    };
+
+    // a plain thread local such that it remains usable during static destruction
+    struct Cache {
+        Block*  free[CLASSES];
+        size_t  count[CLASSES];
+    };
+
+    // flushes the cache of a thread into the depot on thread exit
+    struct Flush {
+        ~Flush() {
+            std::lock_guard<std::mutex> lock(depot_lock());
+            auto& cc = cache();
+            for (size_t c = 0; c < CLASSES; c++) {
+                while (cc.free[c] != nullptr) {
+                    auto b = cc.free[c];
+                    cc.free[c] = b->next;
+                    b->next = depot()[c];
+                    depot()[c] = b;
+                }
+                cc.count[c] = 0;
+            }
+        }
+    };
+
+    static size_t size_class(size_t sz) {
+        return (sz + GRANULE - 1) / GRANULE - 1;
+    }
+
+    static Cache& cache() {
+        static thread_local Cache c;
+        return c;
+    }
+
+    static Block** depot() {
+        static Block* dd[CLASSES];
+        return dd;
+    }
+
+    static std::mutex& depot_lock() {
+        static std::mutex m;
+        return m;
+    }
+
+    // registers the flush of this thread's cache on thread exit
+    static void enlist() {
+        static thread_local Flush flush;
+        (void) flush;
+    }
+
+    // keeps BATCH blocks, hands the rest of the list to the depot
+    static void spill(size_t c) {
+        auto& cc = cache();
+        auto last = cc.free[c];
+        for (size_t n = 1; n < BATCH; n++) last = last->next;
+        auto first = last->next;
+        last->next = nullptr;
+        last = first;
+        while (last->next != nullptr) last = last->next;
+        cc.count[c] = BATCH;
+
+        std::lock_guard<std::mutex> lock(depot_lock());
+        last->next = depot()[c];
+        depot()[c] = first;
+    }
+
+    static void refill(size_t c) {
+        enlist();
+
+        auto& cc = cache();
+        {
+            std::lock_guard<std::mutex> lock(depot_lock());
+            auto& dd = depot()[c];
+            while (dd != nullptr && cc.count[c] < BATCH) {
+                auto b = dd;
+                dd = b->next;
+                b->next = cc.free[c];
+                cc.free[c] = b;
+                cc.count[c]++;
+            }
+        }
+        if (cc.free[c] != nullptr) return;
+
+        size_t bs = (c + 1) * GRANULE;
+        char* chunk = static_cast<char*>(::operator new(CHUNK));
+        for (size_t n = 0; n + bs <= CHUNK; n += bs) {
+            auto b = reinterpret_cast<Block*>(chunk + n);
+            b->next = cc.free[c];
+            cc.free[c] = b;
+            cc.count[c]++;
+        }
+    }
+};
+
+// whether the runtime keeps statistics, see VMStatistics
+inline bool vm_statistics = false;
+
+/**
+ * Statistics on what the runtime does are kept when asked for.
+ *
+ * Allocated objects are counted per tag on construction, with the size
+ * the thread allocated just before, and counted off when freed. The 
+ * machine counts trampoline iterations and, per opcode, the bytecode
+ * instructions run; the builtins are timed. Counters are relaxed 
+ * atomics, only indicative while several threads run.
+ **/
+class VMStatistics {
+public:
+    static const size_t TAGS    = VM_OBJECT_ARRAY + 1;
+    // bytecode.hpp asserts every opcode is below this bound
+    static const size_t OPCODES = 32;
+
+    static void allocated(size_t sz) {
+        pending() = sz;
+    }
+
+    // objects on the stack, or static ones, aren't counted
+    static void created(vm_object_tag_t t) {
+        auto sz = pending();
+        if (sz == 0) return;
+        pending() = 0;
+        auto& s = state();
+        bump(s.objects[t], 1);
+        bump(s.bytes[t], sz);
+        auto n = s.live.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (n > s.peak.load(std::memory_order_relaxed)) {
+            s.peak.store(n, std::memory_order_relaxed);
+        }
+    }
+
+    static void freed() {
+        state().live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static void trampolined(uint64_t n) {
+        bump(state().iterations, n);
+    }
+
+    static void instruction(uint8_t op) {
+        bump(state().instructions[op], 1);
+    }
+
+    static void applied(uint64_t ns) {
+        auto& s = state();
+        bump(s.applies, 1);
+        bump(s.apply_time, ns);
+    }
+
+    static uint64_t objects(vm_object_tag_t t) {
+        return state().objects[t].load(std::memory_order_relaxed);
+    }
+
+    static uint64_t bytes(vm_object_tag_t t) {
+        return state().bytes[t].load(std::memory_order_relaxed);
+    }
+
+    static int64_t live() {
+        return state().live.load(std::memory_order_relaxed);
+    }
+
+    static int64_t peak() {
+        return state().peak.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t iterations() {
+        return state().iterations.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t instructions(uint8_t op) {
+        return state().instructions[op].load(std::memory_order_relaxed);
+    }
+
+    static uint64_t applies() {
+        return state().applies.load(std::memory_order_relaxed);
+    }
+
+    // in nanoseconds
+    static uint64_t apply_time() {
+        return state().apply_time.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct State {
+        std::atomic<uint64_t>   objects[TAGS];
+        std::atomic<uint64_t>   bytes[TAGS];
+        std::atomic<int64_t>    live;
+        std::atomic<int64_t>    peak;
+        std::atomic<uint64_t>   iterations;
+        std::atomic<uint64_t>   instructions[OPCODES];
+        std::atomic<uint64_t>   applies;
+        std::atomic<uint64_t>   apply_time;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+
+    static size_t& pending() {
+        static thread_local size_t sz = 0;
+        return sz;
+    }
+
+    static void bump(std::atomic<uint64_t>& c, uint64_t n) {
+        if (VM_SINGLE_THREADED) {
+            c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        } else {
+            c.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+};
+
+// times a builtin for the statistics over its scope
+class VMApplyTimer {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    VMApplyTimer() {
+        if (vm_statistics) _start = clock::now();
+    }
+
+    ~VMApplyTimer() {
+        if (vm_statistics) {
+            auto d = clock::now() - _start;
+            VMStatistics::applied(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+        }
+    }
+
+private:
+    clock::time_point _start;
+};
+
+/**
+ * VM objects are reference counted with an intrusive count. A handle 
+ * behaves like a smart pointer but has no separate control block.
+ *
+ * Handles are tagged in their two lowest bits
+ * + 00, a counted pointer to an object, or null,
+ * + 01, an immediate integer,
+ * + 10, an immediate char,
+ * + 11, a pinned pointer to an object which lives forever and isn't counted.
+ *
+ * For immediates, the arrow operator returns a shared prototype object
+ * which answers the tag, symbol, and reduce correctly but has no value;
+ * it panics when cloned or rendered. Values are taken with the VM_OBJECT_*_VALUE
+ * macros, rendering goes through operator<< on the handle. The 
+ * VM_OBJECT_*_CAST macros box an immediate, such that the cast object 
+ * answers for its value, at the cost of an allocation.
+ **/
+#define VM_HANDLE_POINTER   0
+#define VM_HANDLE_INTEGER   1
+#define VM_HANDLE_CHAR      2
+#define VM_HANDLE_PINNED    3
+#define VM_HANDLE_MASK      ((uintptr_t) 3)
+
+#define VM_HANDLE_INTEGER_BITS  (sizeof(uintptr_t) * 8 - 2)
+#define VM_HANDLE_INTEGER_MIN   (-((int64_t) 1 << (VM_HANDLE_INTEGER_BITS - 1)))
+#define VM_HANDLE_INTEGER_MAX   (((int64_t) 1 << (VM_HANDLE_INTEGER_BITS - 1)) - 1)
+
+class VMObject;
+inline VMObject* vm_object_prototype(uintptr_t kind);
+
+template <typename T>
+class VMObjectHandle {
+public:
+    VMObjectHandle(): _bits(0) {
+    }
+
+    VMObjectHandle(std::nullptr_t): _bits(0) {
+    }
+
+    template <typename U>
+    explicit VMObjectHandle(U* p): _bits(reinterpret_cast<uintptr_t>(static_cast<T*>(p))) {
+        if (_bits != 0) p->retain();
+    }
+
+    VMObjectHandle(const VMObjectHandle& o): _bits(o._bits) {
+        retain();
+    }
+
+    VMObjectHandle(VMObjectHandle&& o) noexcept: _bits(o._bits) {
+        o._bits = 0;
+    }
+
+    template <typename U>
+    VMObjectHandle(const VMObjectHandle<U>& o): _bits(o.bits()) {
+        static_assert(std::is_convertible<U*, T*>::value, "handle conversion");
+        retain();
+    }
+
+    ~VMObjectHandle() {
+        release();
+    }
+
+    VMObjectHandle& operator=(const VMObjectHandle& o) {
+        VMObjectHandle(o).swap(*this);
+        return *this;
+    }
+
+    VMObjectHandle& operator=(VMObjectHandle&& o) noexcept {
+        VMObjectHandle(std::move(o)).swap(*this);
+        return *this;
+    }
+
+    VMObjectHandle& operator=(std::nullptr_t) {
+        VMObjectHandle().swap(*this);
+        return *this;
+    }
+
+    void swap(VMObjectHandle& o) noexcept {
+        uintptr_t b = _bits;
+        _bits = o._bits;
+        o._bits = b;
+    }
+
+    // immediates and pinned objects
+    static VMObjectHandle from_bits(uintptr_t b) {
+        VMObjectHandle h;
+        h._bits = b;
+        h.retain();
+        return h;
+    }
+
+    static VMObjectHandle from_integer(int64_t v) {
+        return from_bits((static_cast<uintptr_t>(v) << 2) | VM_HANDLE_INTEGER);
+    }
+
+    static VMObjectHandle from_char(UChar32 c) {
+        return from_bits((static_cast<uintptr_t>(static_cast<intptr_t>(c)) << 2) | VM_HANDLE_CHAR);
+    }
+
+    // a pinned object is never freed; the one retain we leak keeps it alive
+    static VMObjectHandle pin(const VMObjectHandle& o) {
+        if (o.kind() != VM_HANDLE_POINTER || o._bits == 0) return o;
+        o.pointer()->retain();
+        return from_bits(o._bits | VM_HANDLE_PINNED);
+    }
+
+    static bool integer_fits(int64_t v) {
+        return (v >= VM_HANDLE_INTEGER_MIN) && (v <= VM_HANDLE_INTEGER_MAX);
+    }
+
+    uintptr_t bits() const {
+        return _bits;
+    }
+
+    uintptr_t kind() const {
+        return _bits & VM_HANDLE_MASK;
+    }
+
+    bool is_immediate() const {
+        return ((_bits + 1) & 2) != 0;
+    }
+
+    bool is_integer() const {
+        return kind() == VM_HANDLE_INTEGER;
+    }
+
+    bool is_char() const {
+        return kind() == VM_HANDLE_CHAR;
+    }
+
+    int64_t integer() const {
+        return static_cast<int64_t>(static_cast<intptr_t>(_bits) >> 2);
+    }
+
+    UChar32 character() const {
+        return static_cast<UChar32>(static_cast<intptr_t>(_bits) >> 2);
+    }
+
+    // whether this is the only reference to a counted object, which may
+    // then be updated in place
+    bool unique() const {
+        return (kind() == VM_HANDLE_POINTER) && (_bits != 0) && pointer()->unique();
+    }
+
+    // the number of references to a counted object, zero otherwise
+    uint32_t count() const {
+        return ((kind() == VM_HANDLE_POINTER) && (_bits != 0)) ? pointer()->count() : 0;
+    }
+
+    // the counted object referred to, if any
+    T* counted() const {
+        return ((kind() == VM_HANDLE_POINTER) && (_bits != 0)) ? pointer() : nullptr;
+    }
+
+    // identity; pinned and counted handles to one object are the same
+    uintptr_t key() const {
+        return (kind() == VM_HANDLE_PINNED) ? (_bits & ~VM_HANDLE_MASK) : _bits;
+    }
+
+    T* get() const {
+        if (is_immediate()) {
+            return static_cast<T*>(vm_object_prototype(kind()));
+        } else {
+            return pointer();
+        }
+    }
+
+    T* operator->() const {
+        return get();
+    }
+
+    T& operator*() const {
+        return *get();
+    }
+
+    explicit operator bool() const {
+        return _bits != 0;
+    }
+
+private:
+    T* pointer() const {
+        return reinterpret_cast<T*>(_bits & ~VM_HANDLE_MASK);
+    }
+
+    void retain() const {
+        if (kind() == VM_HANDLE_POINTER && _bits != 0) pointer()->retain();
+    }
+
+    void release() const {
+        if (kind() == VM_HANDLE_POINTER && _bits != 0) pointer()->release();
+    }
+
+    uintptr_t  _bits;
+};
+
+template <typename T, typename U>
+inline bool operator==(const VMObjectHandle<T>& a, const VMObjectHandle<U>& b) {
+    return a.key() == b.key();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const VMObjectHandle<T>& a, const VMObjectHandle<U>& b) {
+    return a.key() != b.key();
+}
+
+template <typename T, typename U>
+inline bool operator<(const VMObjectHandle<T>& a, const VMObjectHandle<U>& b) {
+    return a.key() < b.key();
+}
+
+template <typename T>
+inline bool operator==(const VMObjectHandle<T>& a, std::nullptr_t) {
+    return a.bits() == 0;
+}
+
+template <typename T>
+inline bool operator!=(const VMObjectHandle<T>& a, std::nullptr_t) {
+    return a.bits() != 0;
+}
+
+template <typename T, typename U>
+inline VMObjectHandle<T> vm_object_cast(const VMObjectHandle<U>& a) {
+    return VMObjectHandle<T>::from_bits(a.bits());
+}
+
 class VMObject;
-typedef std::shared_ptr<VMObject> VMObjectPtr;
+typedef VMObjectHandle<VMObject> VMObjectPtr;
+
+inline void vm_object_reclaim(const VMObject* o);
+inline void vm_object_candidate(const VMObject* o);
+
+// whether garbage cycles are collected, see VMObjectCollector
+inline bool vm_object_tracing = false;
 
 class VMObject {
 public:
-    VMObject(vm_object_tag_t t, vm_object_flag_t f) : _tag(t), _flag(f) {
+    constexpr VMObject(vm_object_tag_t t, vm_object_flag_t f) : _refcount(0), _tag(t), _flag(f), _mark(0) {
+        if (!VM_CONSTANT_EVALUATED() && vm_statistics) VMStatistics::created(t);
+    }
+
+    VMObject(const VMObject& o) : _refcount(0), _tag(o._tag), _flag(o._flag), _mark(0) {
+        if (vm_statistics) VMStatistics::created(o.tag());
+    }
+
+    virtual ~VMObject() {
+    }
+
+    static void* operator new(size_t sz) {
+        if (vm_statistics) VMStatistics::allocated(sz);
+        return VMObjectPool::allocate(sz);
+    }
+
+    // destroy and free the object, objects not allocated with new override this
+    virtual void dispose() const {
+        delete this;
+    }
+
+    static void operator delete(void* p, size_t sz) {
+        if (vm_statistics) VMStatistics::freed();
+        VMObjectPool::release(p, sz);
+    }
+
+    // like the standard library, skip atomic operations while there is only one thread
+    void retain() const {
+        if (VM_SINGLE_THREADED) {
+            _refcount.store(_refcount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            _refcount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release() const {
+        uint32_t n;
+        if (VM_SINGLE_THREADED) {
+            n = _refcount.load(std::memory_order_relaxed);
+            _refcount.store(n - 1, std::memory_order_relaxed);
+        } else {
+            n = _refcount.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        if (n == 1) {
+            vm_object_reclaim(this);
+        } else if (vm_object_tracing) {
+            vm_object_candidate(this);
+        }
+    }
+
+    bool unique() const {
+        return _refcount.load(std::memory_order_acquire) == 1;
+    }
+
+    uint32_t count() const {
+        return _refcount.load(std::memory_order_acquire);
     }
 
     vm_object_tag_t tag() const {
-        return _tag;
+        return static_cast<vm_object_tag_t>(_tag);
     }
 
     vm_object_flag_t flag() const {
-        return _flag;
+        return static_cast<vm_object_flag_t>(_flag);
     }
 
     virtual VMObjectPtr clone() const = 0;
 
-    friend std::ostream& operator<<(std::ostream& os, const VMObjectPtr& a) {
-        a->render(os);
-        return os;
-    }
+    // note: defined later in this header file since immediates render by value
+    friend std::ostream& operator<<(std::ostream& os, const VMObjectPtr& a);
 
     virtual VMObjectPtr reduce(const VMObjectPtr& thunk) const = 0;
 
@@ -161,12 +750,106 @@ public:
     }
 
 private:
-    vm_object_tag_t       _tag;
-    vm_object_flag_t      _flag;
+    friend class VMObjectCollector;
+
+    // tag and flag are kept in bytes, arrays put their size behind them
+    mutable std::atomic<uint32_t>   _refcount;
+    uint8_t                         _tag;
+    uint8_t                         _flag;
+    mutable uint8_t                 _mark;      // used by the collector
 };
 
 typedef std::vector<VMObjectPtr> VMObjectPtrs;
 
+/**
+ * Objects are destroyed from a worklist when destruction nests deeply.
+ *
+ * An object released while DEPTH others are being destroyed is put on
+ * the list of its thread instead, so releasing a long list takes bounded 
+ * stack. The outermost release destroys at most a budget of pending 
+ * objects, what is left is destroyed by later releases, or by draining
+ * the list. A thread which queued objects drains its list when it exits.
+ **/
+class VMObjectReaper {
+public:
+    static const size_t DEPTH  = 64;
+    static const size_t BUDGET = 1024;
+
+    // kept out of line, it sits on the release path of every handle
+    VM_NOINLINE static void reclaim(const VMObject* o) {
+        auto& r = reaper();
+        if (r.depth < DEPTH) {
+            r.depth++;
+            o->dispose();
+            r.depth--;
+            if (r.depth == 0 && r.size > 0) drain(BUDGET);
+        } else {
+            push(o);
+        }
+    }
+
+    // destroy up to n pending objects
+    static void drain(size_t n = std::numeric_limits<size_t>::max()) {
+        auto& r = reaper();
+        if (r.depth > 0) return;
+        r.depth++;
+        while (n > 0 && r.size > 0) {
+            r.pending[--r.size]->dispose();
+            n--;
+        }
+        r.depth--;
+    }
+
+private:
+    // a plain thread local such that it remains usable during static destruction
+    struct Reaper {
+        const VMObject**    pending;
+        size_t              size;
+        size_t              capacity;
+        size_t              depth;
+        bool                guarded;
+    };
+
+    // drains the list when the thread exits, after the objects it held are released
+    struct Guard {
+        ~Guard() {
+            drain();
+            auto& r = reaper();
+            std::free(r.pending);
+            r.pending = nullptr;
+            r.size = r.capacity = 0;
+        }
+    };
+
+    static Reaper& reaper() {
+        static thread_local Reaper r;
+        return r;
+    }
+
+    static void guard() {
+        static thread_local Guard g;
+        (void) g;
+    }
+
+    static void push(const VMObject* o) {
+        auto& r = reaper();
+        if (!r.guarded) {
+            r.guarded = true;
+            guard();
+        }
+        if (r.size == r.capacity) {
+            r.capacity = (r.capacity == 0) ? 256 : 2 * r.capacity;
+            r.pending = static_cast<const VMObject**>(std::realloc(r.pending, r.capacity * sizeof(VMObject*)));
+            if (r.pending == nullptr) PANIC("out of memory");
+        }
+        r.pending[r.size++] = o;
+    }
+};
+
+inline void vm_object_reclaim(const VMObject* o) {
+    VMObjectReaper::reclaim(o);
+}
+
 // the virtual machine
 
 struct VMReduceResult {
@@ -174,6 +857,8 @@ struct VMReduceResult {
     bool        exception;
 };
 
+typedef std::vector<std::pair<icu::UnicodeString, vm_int_t>> Statistics;
+
 class VM {
 public:
     VM() {};
@@ -192,6 +877,8 @@ public:
     virtual data_t enter_data(const VMObjectPtr& o) = 0;
     virtual data_t define_data(const VMObjectPtr& o) = 0;
     virtual VMObjectPtr get_data(const data_t d) = 0;
+    // the address of a data slot is stable and a redefinition is visible through it
+    virtual const VMObjectPtr* get_data_slot(const data_t d) = 0;
 
     // reduce an expression
     virtual void reduce(const VMObjectPtr& e, const VMObjectPtr& ret, const VMObjectPtr& exc) = 0;
@@ -203,19 +890,26 @@ public:
 
     virtual void render(std::ostream& os) = 0;
 
+    // named counters, kept when vm_statistics is set
+    virtual Statistics statistics() = 0;
+
     // convenience routines
     VMObjectPtr get_data_symbol(const symbol_t t);
     VMObjectPtr get_data_string(const icu::UnicodeString& n);
     VMObjectPtr get_data_string(const icu::UnicodeString& n0, const icu::UnicodeString& n1);
     VMObjectPtr get_data_string(const std::vector<icu::UnicodeString>& nn, const icu::UnicodeString& n);
 
+private:
+    // the slots of the predefined symbols, once looked up, builtins ask
+    // for nop, true, and false on every application
+    std::atomic<const VMObjectPtr*> _predefined[SYMBOL_PREDEFINED] = {};
 };
 
 // VM object definitions
 
 class VMObjectLiteral : public VMObject {
 public:
-    VMObjectLiteral(const vm_object_tag_t &t)
+    constexpr VMObjectLiteral(const vm_object_tag_t &t)
         : VMObject(t, VM_OBJECT_FLAG_LITERAL) {
     }
 
@@ -229,7 +923,7 @@ public:
 
 class VMObjectInteger : public VMObjectLiteral {
 public:
-    VMObjectInteger(const vm_int_t &v)
+    constexpr VMObjectInteger(const vm_int_t &v)
         : VMObjectLiteral(VM_OBJECT_INTEGER), _value(v) {
     };
 
@@ -238,14 +932,18 @@ public:
     }
 
     VMObjectPtr clone() const override {
-        return VMObjectPtr(new VMObjectInteger(*this));
+        return create(value());
     }
 
+    // integers which fit in a handle are never allocated
     static VMObjectPtr create(const vm_int_t v) {
-        return VMObjectPtr(new VMObjectInteger(v));
+        if (VMObjectPtr::integer_fits(v)) {
+            return VMObjectPtr::from_integer(v);
+        } else {
+            return VMObjectPtr(new VMObjectInteger(v));
+        }
     }
 
-
     symbol_t symbol() const override {
         return SYMBOL_INT;
     }
@@ -262,13 +960,22 @@ private:
     vm_int_t    _value;
 };
 
-typedef std::shared_ptr<VMObjectInteger> VMObjectIntegerPtr;
+typedef VMObjectHandle<VMObjectInteger> VMObjectIntegerPtr;
+
+inline VMObjectIntegerPtr vm_object_integer_cast(const VMObjectPtr& a) {
+    if (a.is_integer()) {
+        return VMObjectIntegerPtr(new VMObjectInteger(a.integer()));
+    } else {
+        return vm_object_cast<VMObjectInteger>(a);
+    }
+}
+
 #define VM_OBJECT_IS_INTEGER(a) \
-    (a-tag() == VM_OBJECT_INTEGER)
+    (a->tag() == VM_OBJECT_INTEGER)
 #define VM_OBJECT_INTEGER_CAST(a) \
-    std::static_pointer_cast<VMObjectInteger>(a)
+    vm_object_integer_cast(a)
 #define VM_OBJECT_INTEGER_VALUE(a) \
-    (VM_OBJECT_INTEGER_CAST(a)->value())
+    ((a).is_integer()? (a).integer(): vm_object_cast<VMObjectInteger>(a)->value())
 
 class VMObjectFloat : public VMObjectLiteral {
 public:
@@ -307,9 +1014,9 @@ private:
     vm_float_t    _value;
 };
 
-typedef std::shared_ptr<VMObjectFloat> VMObjectFloatPtr;
+typedef VMObjectHandle<VMObjectFloat> VMObjectFloatPtr;
 #define VM_OBJECT_FLOAT_CAST(a) \
-    std::static_pointer_cast<VMObjectFloat>(a)
+    vm_object_cast<VMObjectFloat>(a)
 #define VM_OBJECT_FLOAT_SPLIT(a, v) \
     auto _##a = VM_OBJECT_FLOAT_CAST(a); \
     auto v    = _##a->value();
@@ -318,7 +1025,7 @@ typedef std::shared_ptr<VMObjectFloat> VMObjectFloatPtr;
 
 class VMObjectChar : public VMObjectLiteral {
 public:
-    VMObjectChar(const vm_char_t &v)
+    constexpr VMObjectChar(const vm_char_t &v)
         : VMObjectLiteral(VM_OBJECT_CHAR), _value(v) {
     };
 
@@ -327,11 +1034,12 @@ public:
     }
 
     VMObjectPtr clone() const override {
-        return VMObjectPtr(new VMObjectChar(*this));
+        return create(value());
     }
 
+    // chars are always immediate
     static VMObjectPtr create(const vm_char_t v) {
-        return VMObjectPtr(new VMObjectChar(v));
+        return VMObjectPtr::from_char(v);
     }
 
     symbol_t symbol() const override {
@@ -352,14 +1060,64 @@ private:
     vm_char_t    _value;
 };
 
-typedef std::shared_ptr<VMObjectChar> VMObjectCharPtr;
+typedef VMObjectHandle<VMObjectChar> VMObjectCharPtr;
+
+inline VMObjectCharPtr vm_object_char_cast(const VMObjectPtr& a) {
+    if (a.is_char()) {
+        return VMObjectCharPtr(new VMObjectChar(a.character()));
+    } else {
+        return vm_object_cast<VMObjectChar>(a);
+    }
+}
+
 #define VM_OBJECT_CHAR_CAST(a) \
-    std::static_pointer_cast<VMObjectChar>(a)
-#define VM_OBJECT_CHAR_SPLIT(a, v) \
-    auto _##a = VM_OBJECT_CHAR_CAST(a); \
-    auto v    = _##a->value();
+    vm_object_char_cast(a)
 #define VM_OBJECT_CHAR_VALUE(a) \
-    (VM_OBJECT_CHAR_CAST(a)->value())
+    ((a).is_char()? (a).character(): vm_object_cast<VMObjectChar>(a)->value())
+#define VM_OBJECT_CHAR_SPLIT(a, v) \
+    auto v = VM_OBJECT_CHAR_VALUE(a);
+
+// a prototype has no value, what would answer with one through the arrow panics instead
+template <typename T>
+class VMObjectPrototype : public T {
+public:
+    constexpr VMObjectPrototype()
+        : T(0) {
+    }
+
+    VMObjectPtr clone() const override {
+        PANIC("clone of an immediate, copy the handle");
+        return nullptr;
+    }
+
+    void render(std::ostream& os) const override {
+        PANIC("render of an immediate, render the handle");
+    }
+};
+
+// the prototypes answer for immediates; constant initialized, never counted
+inline VMObjectPrototype<VMObjectInteger>   vm_object_integer_prototype;
+inline VMObjectPrototype<VMObjectChar>      vm_object_char_prototype;
+
+// not const; the optimizer shouldn't follow a prototype into a cast to another type
+inline VMObject* vm_object_prototypes[] = {
+    nullptr, &vm_object_integer_prototype, &vm_object_char_prototype, nullptr,
+};
+
+inline VMObject* vm_object_prototype(uintptr_t kind) {
+    return vm_object_prototypes[kind];
+}
+
+inline std::ostream& operator<<(std::ostream& os, const VMObjectPtr& a) {
+    if (a.is_integer()) {
+        os << a.integer();
+    } else if (a.is_char()) {
+        VMObjectChar(a.character()).render(os);
+    } else {
+        a->render(os);
+    }
+    return os;
+}
 
 class VMObjectText : public VMObjectLiteral {
 public:
@@ -410,13 +1168,18 @@ public:
         return _value;
     }
 
+    // the text itself, only to be changed through a unique handle
+    icu::UnicodeString& update() {
+        return _value;
+    }
+
 private:
     icu::UnicodeString    _value;
 };
 
-typedef std::shared_ptr<VMObjectText> VMObjectTextPtr;
+typedef VMObjectHandle<VMObjectText> VMObjectTextPtr;
 #define VM_OBJECT_TEXT_CAST(a) \
-    std::static_pointer_cast<VMObjectText>(a)
+    vm_object_cast<VMObjectText>(a)
 #define VM_OBJECT_TEXT_SPLIT(a, v) \
     auto _##a = VM_OBJECT_TEXT_CAST(a); \
     auto v    = _##a->value();
@@ -457,67 +1220,128 @@ private:
     vm_ptr_t    _value;
 };
 
-typedef std::shared_ptr<VMObjectPointer> VMObjectPointerPtr;
+typedef VMObjectHandle<VMObjectPointer> VMObjectPointerPtr;
 #define VM_OBJECT_POINTER_CAST(a) \
-    std::static_pointer_cast<VMObjectPointer>(a)
+    vm_object_cast<VMObjectPointer>(a)
 #define VM_OBJECT_POINTER_SPLIT(a, v) \
     auto _##a = VM_OBJECT_POINTER_CAST(a); \
     auto v    = _##a->value();
 #define VM_OBJECT_POINTER_VALUE(a) \
     (VM_OBJECT_POINTER_CAST(a)->value())
 
+/**
+ * Arrays keep their slots inline, right behind the object.
+ *
+ * An array has a fixed size and is allocated in one pooled block, a cons 
+ * cell or a small thunk takes a single allocation. Arrays are made with 
+ * null slots by allocate, which are then filled with set, or by create 
+ * from other slots.
+ **/
 class VMObjectArray : public VMObject {
 public:
-    VMObjectArray()
-        : VMObject(VM_OBJECT_ARRAY, VM_OBJECT_FLAG_INTERNAL), _value(VMObjectPtrs()) {
-    };
+    static void* operator new(size_t sz) = delete;
 
-    VMObjectArray(const VMObjectPtrs &v)
-        : VMObject(VM_OBJECT_ARRAY, VM_OBJECT_FLAG_INTERNAL), _value(v) {
-    };
+    ~VMObjectArray() {
+        auto ss = slots();
+        for (uint i = 0; i < _size; i++) ss[i].~VMObjectPtr();
+    }
 
-    VMObjectArray(const VMObjectArray& l)
-        : VMObjectArray(l.value()) {
+    // an array the collector still remembers only lets go of its slots,
+    // the collector frees it later
+    void dispose() const override;
+
+    // free without releasing the slots, for garbage cycles whose counts 
+    // the collector already took apart
+    void discard() const {
+        if (vm_statistics) VMStatistics::freed();
+        VMObjectPool::release(const_cast<VMObjectArray*>(this), bytes(_size));
     }
 
     VMObjectPtr clone() const override {
-        if (size() == 1) {
-            return get(0);
-        } else {
-            return VMObjectPtr(new VMObjectArray(*this));
-        }
+        return create(*this, 0, size());
     }
 
-    static VMObjectPtr create() {
-        return VMObjectPtr(new VMObjectArray());
+    // an array of n null slots
+    static VMObjectArray* allocate(uint n) {
+        auto a = make(n);
+        auto ss = a->slots();
+        for (uint i = 0; i < n; i++) ::new (&ss[i]) VMObjectPtr();
+        return a;
     }
 
     static VMObjectPtr create(const VMObjectPtrs& pp) {
         if (pp.size() == 1) {
             return pp[0];
         } else {
-            return VMObjectPtr(new VMObjectArray(pp));
+            return VMObjectPtr(copy(pp.data(), pp.size()));
         }
     }
 
+    // the slots [from, to) of an array, a sole slot is returned as is
+    static VMObjectPtr create(const VMObjectArray& l, uint from, uint to) {
+        if (to - from == 1) {
+            return l[from];
+        } else {
+            return VMObjectPtr(copy(l.begin() + from, to - from));
+        }
+    }
+
+    // the shapes of tuples, cons cells, and the like
+    static VMObjectPtr create(const VMObjectPtr& a0, const VMObjectPtr& a1) {
+        auto a = make(2);
+        auto ss = a->slots();
+        ::new (&ss[0]) VMObjectPtr(a0);
+        ::new (&ss[1]) VMObjectPtr(a1);
+        return VMObjectPtr(a);
+    }
+
+    static VMObjectPtr create(const VMObjectPtr& a0, const VMObjectPtr& a1, const VMObjectPtr& a2) {
+        auto a = make(3);
+        auto ss = a->slots();
+        ::new (&ss[0]) VMObjectPtr(a0);
+        ::new (&ss[1]) VMObjectPtr(a1);
+        ::new (&ss[2]) VMObjectPtr(a2);
+        return VMObjectPtr(a);
+    }
+
+    static VMObjectPtr create(const VMObjectPtr& a0, const VMObjectPtr& a1, const VMObjectPtr& a2,
+                              const VMObjectPtr& a3) {
+        auto a = make(4);
+        auto ss = a->slots();
+        ::new (&ss[0]) VMObjectPtr(a0);
+        ::new (&ss[1]) VMObjectPtr(a1);
+        ::new (&ss[2]) VMObjectPtr(a2);
+        ::new (&ss[3]) VMObjectPtr(a3);
+        return VMObjectPtr(a);
+    }
+
     symbol_t symbol() const override {
-        return _value[0]->symbol();
+        return slots()[0]->symbol();
     }
 
     int size() const {
-        return _value.size();
+        return _size;
     }
 
     VMObjectPtr get(uint i) const {
-        return _value[i];
+        return slots()[i];
     }
 
-    void set(uint i, const VMObjectPtr& o) {
-        _value[i] = o;
+    // borrowed access, valid while the array is alive and unchanged
+    const VMObjectPtr& operator[](uint i) const {
+        return slots()[i];
     }
 
-    void push_back(const VMObjectPtr& o) {
-        _value.push_back(o);
+    const VMObjectPtr* begin() const {
+        return slots();
+    }
+
+    const VMObjectPtr* end() const {
+        return slots() + _size;
+    }
+
+    void set(uint i, const VMObjectPtr& o) {
+        slots()[i] = o;
     }
 
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override;
@@ -529,7 +1353,7 @@ public:
     void render(std::ostream& os) const override {
         os << '(';
         bool first = true;
-        for (auto& v:value()) {
+        for (auto& v:*this) {
             if (first) {
                 first = false;
             } else {
@@ -538,89 +1362,429 @@ public:
             if (v == nullptr) {
                 os << ".";
             } else {
-                v->render(os);
+                os << v;
             }
         }
         os << ')';
     }
 
+    // a copy of all slots; counted since the runtime should not need them
     VMObjectPtrs value() const {
-        return _value;
+        _copies.fetch_add(1, std::memory_order_relaxed);
+        return VMObjectPtrs(begin(), end());
+    }
+
+    static uint64_t copies() {
+        return _copies.load(std::memory_order_relaxed);
     }
 
 private:
-    VMObjectPtrs  _value;
+    VMObjectArray(uint n)
+        : VMObject(VM_OBJECT_ARRAY, VM_OBJECT_FLAG_INTERNAL), _size(n) {
+    }
+
+    static size_t bytes(uint n) {
+        return sizeof(VMObjectArray) + n * sizeof(VMObjectPtr);
+    }
+
+    // the object with room for n slots, which are left unconstructed
+    static VMObjectArray* make(uint n) {
+        if (vm_statistics) VMStatistics::allocated(bytes(n));
+        return ::new (VMObjectPool::allocate(bytes(n))) VMObjectArray(n);
+    }
+
+    static VMObjectArray* copy(const VMObjectPtr* pp, uint n) {
+        auto a = make(n);
+        auto ss = a->slots();
+        for (uint i = 0; i < n; i++) ::new (&ss[i]) VMObjectPtr(pp[i]);
+        return a;
+    }
+
+    VMObjectPtr* slots() const {
+        return reinterpret_cast<VMObjectPtr*>(const_cast<VMObjectArray*>(this) + 1);
+    }
+
+    // the size sits in the tail padding of the object header
+    uint32_t    _size;
+    static inline std::atomic<uint64_t> _copies{0};
 };
 
-typedef std::shared_ptr<VMObjectArray> VMObjectArrayPtr;
+typedef VMObjectHandle<VMObjectArray> VMObjectArrayPtr;
 #define VM_OBJECT_ARRAY_CAST(a) \
-    std::static_pointer_cast<VMObjectArray>(a)
+    vm_object_cast<VMObjectArray>(a)
 #define VM_OBJECT_ARRAY_SPLIT(a, v) \
     auto _##a = VM_OBJECT_ARRAY_CAST(a); \
     auto v    = _##a->value();
 #define VM_OBJECT_ARRAY_VALUE(a) \
     (VM_OBJECT_ARRAY_CAST(a)->value())
+#define VM_OBJECT_ARRAY_REF(a) \
+    (*static_cast<const VMObjectArray*>((a).get()))
 
-// here we can safely declare reduce
-inline VMObjectPtr VMObjectLiteral::reduce(const VMObjectPtr& thunk) const {
-    auto tt    = VM_OBJECT_ARRAY_CAST(thunk);
-    // optimize a bit for the case it's either a sole literal or an applied literal
-    if (tt->size() == 5) {
-        auto rt    = tt->get(0);
-        auto rti   = tt->get(1);
-        auto k     = tt->get(2);
-        // auto exc   = tt[3];
-        auto c     = tt->get(4);
-
-        auto index = VM_OBJECT_INTEGER_VALUE(rti);
-        auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-        rta->set(index, c);
-
-        return k;
-    } else {
-        auto rt    = tt->get(0);
-        auto rti   = tt->get(1);
-        auto k     = tt->get(2);
+/**
+ * Garbage cycles are collected by trial deletion when tracing is on.
+ *
+ * Counting doesn't reclaim cyclic structures, which setv can build. 
+ * With tracing on, an array whose count drops but not to zero is 
+ * remembered as the possible root of a garbage cycle. Once enough are
+ * remembered, the counts of everything reachable from them are lowered
+ * by the references from within; what then drops to zero is referenced
+ * from within only and is freed, the other counts are restored. This 
+ * is the synchronous cycle collector of Bacon and Rajan.
+ *
+ * Objects other than arrays are leaves, references they hide count as
+ * references from outside. The collector only runs while there is one 
+ * thread, from the trampoline; tracing stops for good when the program
+ * starts threads.
+ *
+ * Live structures reachable from candidates are traced on every
+ * collection, a long list being consumed is traced over and over. The
+ * next collection therefore waits for as many candidates as the last
+ * one traced objects, which keeps the work linear in the candidates.
+ **/
+class VMObjectCollector {
+public:
+    static constexpr size_t THRESHOLD = 8 * 1024;
+
+    enum {
+        BLACK    = 0,   // in use, or not looked at
+        GRAY     = 1,   // possibly garbage
+        WHITE    = 2,   // garbage
+        PURPLE   = 3,   // possible root
+        COLOR    = 3,
+        BUFFERED = 4,   // on the list of possible roots
+    };
+
+    typedef struct {
+        uint64_t    collections;
+        uint64_t    candidates;
+        uint64_t    freed;
+    } statistics_t;
+
+    VM_NOINLINE static void candidate(const VMObject* o) {
+        if (!VM_SINGLE_THREADED || o->tag() != VM_OBJECT_ARRAY) return;
+        if (color(o) == PURPLE) return;
+        paint(o, PURPLE);
+        if (!(o->_mark & BUFFERED)) {
+            o->_mark |= BUFFERED;
+            state().roots.push_back(o);
+            state().statistics.candidates++;
+        }
+    }
+
+    static void poll() {
+        auto& st = state();
+        if (st.roots.size() >= st.threshold) collect();
+    }
+
+    // hand the remembered arrays back to counting and stop tracing, 
+    // before the program starts threads
+    static void stop() {
+        if (!vm_object_tracing) return;
+        vm_object_tracing = false;
+
+        auto& st = state();
+        for (auto o:st.roots) {
+            o->_mark &= ~BUFFERED;
+            paint(o, BLACK);
+            // an array which was let go of while remembered
+            if (count(o) == 0) o->dispose();
+        }
+        st.roots.clear();
+        st.roots.shrink_to_fit();
+    }
+
+    static void collect() {
+        if (!VM_SINGLE_THREADED) return;
+        auto& st = state();
+        st.statistics.collections++;
+
+        // releases while collecting may remember new candidates
+        std::vector<const VMObject*> roots;
+        roots.swap(st.roots);
+
+        std::vector<const VMObject*> gray;
+        size_t traced = 0;
+        for (auto o:roots) {
+            if (color(o) == PURPLE && count(o) > 0) {
+                traced += mark_gray(o);
+                gray.push_back(o);
+            } else {
+                o->_mark &= ~BUFFERED;
+                // an array which was let go of while remembered
+                if (color(o) == BLACK && count(o) == 0) {
+                    o->dispose();
+                }
+            }
+        }
+        for (auto o:gray) scan(o);
+        st.threshold = std::max(THRESHOLD, traced);
 
-        VMObjectPtrs vv;
-        for (uint n = 4; (int) n < tt->size(); n++) {
-            vv.push_back(tt->get(n));
+        std::vector<const VMObject*> white;
+        for (auto o:gray) {
+            o->_mark &= ~BUFFERED;
+            collect_white(o, white);
         }
+        st.statistics.freed += white.size();
+        for (auto o:white) {
+            if (o->tag() == VM_OBJECT_ARRAY) {
+                static_cast<const VMObjectArray*>(o)->discard();
+            } else {
+                o->dispose();
+            }
+        }
+    }
 
-        auto r = VMObjectArray(vv).clone();
+    static statistics_t statistics() {
+        return state().statistics;
+    }
+
+    static bool remembered(const VMObject* o) {
+        return (o->_mark & BUFFERED) != 0;
+    }
+
+    static void let_go(const VMObject* o) {
+        paint(o, BLACK);
+    }
 
-        auto index = VM_OBJECT_INTEGER_VALUE(rti);
-        auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-        rta->set(index, r);
+private:
+    struct State {
+        std::vector<const VMObject*>    roots;
+        size_t                          threshold = THRESHOLD;
+        statistics_t                    statistics;
+    };
 
-        return k;
+    static State& state() {
+        static State s;
+        return s;
     }
+
+    static int color(const VMObject* o) {
+        return o->_mark & COLOR;
+    }
+
+    static void paint(const VMObject* o, int c) {
+        o->_mark = (o->_mark & ~COLOR) | c;
+    }
+
+    static uint32_t count(const VMObject* o) {
+        return o->_refcount.load(std::memory_order_relaxed);
+    }
+
+    static void adjust(const VMObject* o, int d) {
+        o->_refcount.store(count(o) + d, std::memory_order_relaxed);
+    }
+
+    // the traced references of an object
+    template <typename F>
+    static void children(const VMObject* o, F f) {
+        if (o->tag() != VM_OBJECT_ARRAY) return;
+        for (auto& a:*static_cast<const VMObjectArray*>(o)) {
+            auto c = a.counted();
+            if (c != nullptr) f(c);
+        }
+    }
+
+    // remove the references from within, the graph may be deep so 
+    // none of these recurse; answers the number of objects traced
+    static size_t mark_gray(const VMObject* o) {
+        if (color(o) == GRAY) return 0;
+        paint(o, GRAY);
+        size_t n = 0;
+        std::vector<const VMObject*> todo = { o };
+        while (!todo.empty()) {
+            auto s = todo.back();
+            todo.pop_back();
+            n++;
+            children(s, [&](const VMObject* t) {
+                adjust(t, -1);
+                if (color(t) != GRAY) {
+                    paint(t, GRAY);
+                    todo.push_back(t);
+                }
+            });
+        }
+        return n;
+    }
+
+    // what is still referenced is in use, the rest garbage
+    static void scan(const VMObject* o) {
+        std::vector<const VMObject*> todo = { o };
+        while (!todo.empty()) {
+            auto s = todo.back();
+            todo.pop_back();
+            if (color(s) != GRAY) continue;
+            if (count(s) > 0) {
+                scan_black(s);
+            } else {
+                paint(s, WHITE);
+                children(s, [&](const VMObject* t) { todo.push_back(t); });
+            }
+        }
+    }
+
+    // restore the references from what is in use
+    static void scan_black(const VMObject* o) {
+        paint(o, BLACK);
+        std::vector<const VMObject*> todo = { o };
+        while (!todo.empty()) {
+            auto s = todo.back();
+            todo.pop_back();
+            children(s, [&](const VMObject* t) {
+                adjust(t, 1);
+                if (color(t) != BLACK) {
+                    paint(t, BLACK);
+                    todo.push_back(t);
+                }
+            });
+        }
+    }
+
+    // gather the garbage, remembered objects are gathered in their turn
+    static void collect_white(const VMObject* o, std::vector<const VMObject*>& white) {
+        std::vector<const VMObject*> todo = { o };
+        while (!todo.empty()) {
+            auto s = todo.back();
+            todo.pop_back();
+            if (color(s) != WHITE || (s->_mark & BUFFERED)) continue;
+            paint(s, BLACK);
+            white.push_back(s);
+            children(s, [&](const VMObject* t) { todo.push_back(t); });
+        }
+    }
+};
+
+inline void vm_object_candidate(const VMObject* o) {
+    VMObjectCollector::candidate(o);
+}
+
+inline void VMObjectArray::dispose() const {
+    if (VMObjectCollector::remembered(this)) {
+        auto ss = slots();
+        for (uint i = 0; i < _size; i++) ss[i] = nullptr;
+        VMObjectCollector::let_go(this);
+        return;
+    }
+    auto sz = bytes(_size);
+    this->~VMObjectArray();
+    if (vm_statistics) VMStatistics::freed();
+    VMObjectPool::release(const_cast<VMObjectArray*>(this), sz);
+}
+
+// a frame is a borrowed view on a thunk [rt, rti, k, exc, c, args..];
+// it doesn't copy slots and is only valid while the thunk is
+class VMFrame {
+public:
+    VMFrame(const VMObjectPtr& thunk)
+        : _thunk(static_cast<const VMObjectArray*>(thunk.get())) {
+    }
+
+    uint size() const {
+        return _thunk->size();
+    }
+
+    const VMObjectPtr& operator[](uint i) const {
+        return (*_thunk)[i];
+    }
+
+    const VMObjectPtr& rt() const {
+        return (*_thunk)[0];
+    }
+
+    const VMObjectPtr& rti() const {
+        return (*_thunk)[1];
+    }
+
+    const VMObjectPtr& k() const {
+        return (*_thunk)[2];
+    }
+
+    const VMObjectPtr& exc() const {
+        return (*_thunk)[3];
+    }
+
+    const VMObjectPtr& c() const {
+        return (*_thunk)[4];
+    }
+
+    // the slots [from, size) as a result, a sole slot is returned as is
+    VMObjectPtr slice(uint from) const {
+        return VMObjectArray::create(*_thunk, from, size());
+    }
+
+    // a result r applied to the spurious arguments from slot 'from' onward
+    VMObjectPtr applied(const VMObjectPtr& r, uint from) const {
+        if (from >= size()) return r;
+        auto aa = VMObjectArray::allocate(1 + size() - from);
+        aa->set(0, r);
+        for (uint i = from; i < size(); i++) {
+            aa->set(1 + i - from, (*_thunk)[i]);
+        }
+        return VMObjectPtr(aa);
+    }
+
+    // a new thunk which reduces r with the spurious arguments from slot 'from' onward
+    VMObjectPtr continuation(const VMObjectPtr& r, uint from) const {
+        auto aa = VMObjectArray::allocate(5 + (from < size() ? size() - from : 0));
+        for (uint i = 0; i < 4; i++) {
+            aa->set(i, (*_thunk)[i]);
+        }
+        aa->set(4, r);
+        for (uint i = from; i < size(); i++) {
+            aa->set(5 + i - from, (*_thunk)[i]);
+        }
+        return VMObjectPtr(aa);
+    }
+
+    // the handler thunk with exception e filled in
+    VMObjectPtr exception(const VMObjectPtr& e) const {
+        auto& ee = *static_cast<const VMObjectArray*>(exc().get());
+        auto aa = VMObjectArray::allocate(6);
+        for (uint i = 0; i < 5; i++) {
+            aa->set(i, ee[i]);
+        }
+        aa->set(5, e);
+        return VMObjectPtr(aa);
+    }
+
+    // write the result to the return slot
+    void result(const VMObjectPtr& r) const {
+        auto index = VM_OBJECT_INTEGER_VALUE(rti());
+        static_cast<VMObjectArray*>(rt().get())->set(index, r);
+    }
+
+private:
+    const VMObjectArray* _thunk;
+};
+
+// here we can safely declare reduce
+inline VMObjectPtr VMObjectLiteral::reduce(const VMObjectPtr& thunk) const {
+    VMFrame tt(thunk);
+    // optimize a bit for the case it's either a sole literal or an applied literal
+    if (tt.size() == 5) {
+        tt.result(tt.c());
+    } else {
+        tt.result(tt.slice(4));
+    }
+    return tt.k();
 }
 
 inline VMObjectPtr VMObjectArray::reduce(const VMObjectPtr& thunk) const {
-    auto tt    = VM_OBJECT_ARRAY_VALUE(thunk);
-    auto rt    = tt[0];
-    auto rti   = tt[1];
-    auto k     = tt[2];
-    auto exc   = tt[3];
-    auto c     = tt[4];
-
-    VMObjectPtrs vv;
-    vv.push_back(rt);
-    vv.push_back(rti);
-    vv.push_back(k);
-    vv.push_back(exc);
-    auto aa = VM_OBJECT_ARRAY_VALUE(c);
+    VMFrame tt(thunk);
+    auto& aa = *static_cast<const VMObjectArray*>(tt.c().get());
+
+    auto t = VMObjectArray::allocate(4 + aa.size() + tt.size() - 5);
+    uint i = 0;
+    for (uint n = 0; n < 4; n++) {
+        t->set(i++, tt[n]);
+    }
     for (auto& a:aa) {
-        vv.push_back(a);
+        t->set(i++, a);
     }
     for (uint n = 5; n < tt.size(); n++) {
-        vv.push_back(tt[n]);
+        t->set(i++, tt[n]);
     }
 
-    auto t = VMObjectArray(vv).clone();
-
-    return t;
+    return VMObjectPtr(t);
 }
 
 class VMObjectOpaque : public VMObject {
@@ -654,30 +1818,15 @@ public:
     }
 
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
-        // auto exc   = tt[3];
-        // auto c   = tt[4];
-
-        VMObjectPtr ret;
+        VMFrame tt(thunk);
+
         if (tt.size() > 5) {
-            VMObjectPtrs rr;
-            for (uint i = 4; i < tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            ret = VMObjectArray(rr).clone();
+            tt.result(tt.slice(4));
         } else {
-            ret = tt[4];
+            tt.result(tt.c());
         }
 
-        auto index = VM_OBJECT_INTEGER_VALUE(rti);
-        auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-        rta->set(index, ret);
-
-        
-        return k;
+        return tt.k();
     }
 
     void debug(std::ostream& os) const override {
@@ -696,14 +1845,18 @@ private:
     symbol_t    _symbol;
 };
 
-typedef std::shared_ptr<VMObjectOpaque> VMObjectOpaquePtr;
+typedef VMObjectHandle<VMObjectOpaque> VMObjectOpaquePtr;
 #define VM_OBJECT_OPAQUE_CAST(a) \
-    std::static_pointer_cast<VMObjectOpaque>(a)
+    vm_object_cast<VMObjectOpaque>(a)
 #define VM_OBJECT_OPAQUE_COMPARE(o0, o1) \
     (VM_OBJECT_OPAQUE_CAST(o0))->compare(o1);
 #define VM_OBJECT_OPAQUE_SYMBOL(a) \
     (VM_OBJECT_OPAQUE_CAST(a)->symbol())
 
+// a combinator applied to fewer arguments than its arity reduces to 
+// itself applied to them, the arity of some combinators isn't known
+#define VM_ARITY_UNKNOWN    (-1)
+
 class VMObjectCombinator : public VMObject {
 public:
     VMObjectCombinator(const vm_object_flag_t f, VM* m, const symbol_t s)
@@ -734,6 +1887,10 @@ public:
         return _machine->get_symbol(_symbol);
     }
 
+    virtual int arity() const {
+        return VM_ARITY_UNKNOWN;
+    }
+
     void debug(std::ostream& os) const override {
         render(os);
     }
@@ -766,6 +1923,20 @@ public:
         return VMObjectText::create(v);
     }
 
+    // the text a with f applied to it; a text nothing else refers to is 
+    // changed in place, otherwise a copy is
+    template <typename F>
+    VMObjectPtr update_text(const VMObjectPtr& a, F f) const {
+        if (a.unique()) {
+            f(VM_OBJECT_TEXT_CAST(a)->update());
+            return a;
+        } else {
+            auto v = VM_OBJECT_TEXT_VALUE(a);
+            f(v);
+            return VMObjectText::create(v);
+        }
+    }
+
     VMObjectPtr create_nop() const {
         return _machine->get_data_symbol(SYMBOL_NOP);
     }
@@ -817,42 +1988,37 @@ public:
     }
 
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
-        // auto exc   = tt[3];
-        // auto c   = tt[4];
-
-        VMObjectPtr ret;
+        VMFrame tt(thunk);
+
         if (tt.size() > 5) {
-            VMObjectPtrs rr;
-            for (uint i = 4; i < tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            ret = VMObjectArray(rr).clone();
+            tt.result(tt.slice(4));
         } else {
-            ret = tt[4];
+            tt.result(tt.c());
         }
 
-        auto index = VM_OBJECT_INTEGER_VALUE(rti);
-        auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-        rta->set(index, ret);
-
-        
-        return k;
+        return tt.k();
     }
 };
 
-typedef std::shared_ptr<VMObjectCombinator> VMObjectCombinatorPtr;
+typedef VMObjectHandle<VMObjectCombinator> VMObjectCombinatorPtr;
 #define VM_OBJECT_COMBINATOR_CAST(a) \
-    std::static_pointer_cast<VMObjectCombinator>(a)
+    vm_object_cast<VMObjectCombinator>(a)
 #define VM_OBJECT_COMBINATOR_SYMBOL(a) \
     (VM_OBJECT_COMBINATOR_CAST(a)->symbol())
 
 struct CompareVMObjectPtr 
 {
     int operator() (const VMObjectPtr& a0, const VMObjectPtr& a1) const{
+        // fast path for immediates of the same kind, and for identical objects
+        if (a0.is_immediate() && (a0.kind() == a1.kind())) {
+            auto v0 = a0.integer(); // for chars too, both are encoded sign extended
+            auto v1 = a1.integer();
+            if (v0 < v1) return -1;
+            else if (v1 < v0) return 1;
+            else return 0;
+        }
+        if (a0 == a1) return 0;
+
         auto t0 = a0->tag();
         auto t1 = a1->tag();
         if (t0 < t1) {
@@ -918,15 +2084,15 @@ struct CompareVMObjectPtr
                 }
                 break;
             case VM_OBJECT_ARRAY: {
-                    auto v0 = VM_OBJECT_ARRAY_VALUE(a0);
-                    auto v1 = VM_OBJECT_ARRAY_VALUE(a1);
+                    auto& v0 = *static_cast<const VMObjectArray*>(a0.get());
+                    auto& v1 = *static_cast<const VMObjectArray*>(a1.get());
                     auto s0 = v0.size();
                     auto s1 = v1.size();
 
                     if (s0 < s1) return -1;
                     else if (s1 < s0) return 1;
                     else {
-                        for (unsigned int i = 0; i < s0; i++) {
+                        for (int i = 0; i < s0; i++) {
                             auto c = operator()(v0[i], v1[i]);
                             if (c < 0) return -1;
                             if (c > 0) return 1;
@@ -981,8 +2147,15 @@ public:
 };
 
 inline VMObjectPtr VM::get_data_symbol(const symbol_t s) {
+    if (s < SYMBOL_PREDEFINED) {
+        auto p = _predefined[s].load(std::memory_order_relaxed);
+        if (p != nullptr) return *p;
+    }
     auto o = VMObjectStub(this, s).clone();
     auto d = enter_data(o);
+    if (s < SYMBOL_PREDEFINED) {
+        _predefined[s].store(get_data_slot(d), std::memory_order_relaxed);
+    }
     return get_data(d);
 }
 
@@ -1021,12 +2194,8 @@ public:
         // when throw is reduced, it takes the exception, inserts it argument, 
         // and reduces that
 
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        // auto rt  = tt[0];
-        // auto rti = tt[1];
-        // auto k   = tt[2];
-        auto exc   = tt[3];
-        // auto c   = tt[4];
+        VMFrame tt(thunk);
+        auto exc   = tt.exc();
         auto r     = tt[5];
 
         auto ee = VM_OBJECT_ARRAY_CAST(exc);
@@ -1067,62 +2236,36 @@ public:
          VMObjectCombinator(VM_OBJECT_FLAG_INTERNAL, m, s) {
     }
 
+    int arity() const override {
+        return 0;
+    }
+
     virtual VMObjectPtr apply() const = 0;
         
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
+        VMFrame tt(thunk);
 
         VMObjectPtr r;
         if (tt.size() > 4) {
             try {
+                VMApplyTimer timer;
                 r = apply();
                 if (r == nullptr) {
-                    VMObjectPtrs rr;
-                    for (uint i = 4; i<tt.size(); i++) {
-                        rr.push_back(tt[i]);
-                    }
-                    r = VMObjectArray(rr).clone();
+                    r = tt.slice(4);
                 }
             } catch (VMObjectPtr e) {
-                auto exc   = tt[3];
-                auto ee    = VM_OBJECT_ARRAY_VALUE(exc);
-
-                VMObjectPtrs rr;
-                rr.push_back(ee[0]);
-                rr.push_back(ee[1]);
-                rr.push_back(ee[2]);
-                rr.push_back(ee[3]);
-                rr.push_back(ee[4]);
-                rr.push_back(e);
-
-                return VMObjectArray(rr).clone();
+                return tt.exception(e);
             }
         } else {
-            VMObjectPtrs rr;
-            for (uint i = 4; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
+            r = tt.slice(4);
         }
 
         // also return spurious arguments
-        if (tt.size() > 5) {
-            VMObjectPtrs rr;
-            rr.push_back(r);
-            for (uint i = 5; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
-        }
+        r = tt.applied(r, 5);
 
-        auto index = VM_OBJECT_INTEGER_VALUE(rti);
-        auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-        rta->set(index, r);
+        tt.result(r);
 
-        return k;
+        return tt.k();
     }
 };
 
@@ -1147,64 +2290,38 @@ public:
          VMObjectCombinator(VM_OBJECT_FLAG_INTERNAL, m, s) {
     }
 
+    int arity() const override {
+        return 1;
+    }
+
     virtual VMObjectPtr apply(const VMObjectPtr& arg0) const = 0;
         
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
+        VMFrame tt(thunk);
 
         VMObjectPtr r;
         if (tt.size() > 5) {
-            auto arg0 = tt[5];
+            auto& arg0 = tt[5];
 
             try {
+                VMApplyTimer timer;
                 r = apply(arg0);
                 if (r == nullptr) {
-                    VMObjectPtrs rr;
-                    for (uint i = 4; i<tt.size(); i++) {
-                        rr.push_back(tt[i]);
-                    }
-                    r = VMObjectArray(rr).clone();
+                    r = tt.slice(4);
                 }
             } catch (VMObjectPtr e) {
-                auto exc   = tt[3];
-                auto ee    = VM_OBJECT_ARRAY_VALUE(exc);
-
-                VMObjectPtrs rr;
-                rr.push_back(ee[0]);
-                rr.push_back(ee[1]);
-                rr.push_back(ee[2]);
-                rr.push_back(ee[3]);
-                rr.push_back(ee[4]);
-                rr.push_back(e);
-
-                return VMObjectArray(rr).clone();
+                return tt.exception(e);
             }
         } else {
-            VMObjectPtrs rr;
-            for (uint i = 4; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
+            r = tt.slice(4);
         }
 
         // also return spurious arguments
-        if (tt.size() > 6) {
-            VMObjectPtrs rr;
-            rr.push_back(r);
-            for (uint i = 6; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
-        }
+        r = tt.applied(r, 6);
 
-        auto index = VM_OBJECT_INTEGER_VALUE(rti);
-        auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-        rta->set(index, r);
+        tt.result(r);
 
-        return k;
+        return tt.k();
     }
 };
 
@@ -1229,65 +2346,39 @@ public:
          VMObjectCombinator(VM_OBJECT_FLAG_INTERNAL, m, s) {
     }
 
+    int arity() const override {
+        return 2;
+    }
+
     virtual VMObjectPtr apply(const VMObjectPtr& arg0, const VMObjectPtr& arg1) const = 0;
         
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
+        VMFrame tt(thunk);
 
         VMObjectPtr r;
         if (tt.size() > 6) {
-            auto arg0 = tt[5];
-            auto arg1 = tt[6];
+            auto& arg0 = tt[5];
+            auto& arg1 = tt[6];
 
             try {
+                VMApplyTimer timer;
                 r = apply(arg0, arg1);
                 if (r == nullptr) {
-                    VMObjectPtrs rr;
-                    for (uint i = 4; i<tt.size(); i++) {
-                        rr.push_back(tt[i]);
-                    }
-                    r = VMObjectArray(rr).clone();
+                    r = tt.slice(4);
                 }
             } catch (VMObjectPtr e) {
-                auto exc   = tt[3];
-                auto ee    = VM_OBJECT_ARRAY_VALUE(exc);
-
-                VMObjectPtrs rr;
-                rr.push_back(ee[0]);
-                rr.push_back(ee[1]);
-                rr.push_back(ee[2]);
-                rr.push_back(ee[3]);
-                rr.push_back(ee[4]);
-                rr.push_back(e);
-
-                return VMObjectArray(rr).clone();
+                return tt.exception(e);
             }
         } else {
-            VMObjectPtrs rr;
-            for (uint i = 4; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
+            r = tt.slice(4);
         }
 
         // also return spurious arguments
-        if (tt.size() > 7) {
-            VMObjectPtrs rr;
-            rr.push_back(r);
-            for (uint i = 7; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
-        }
+        r = tt.applied(r, 7);
 
-        auto index = VM_OBJECT_INTEGER_VALUE(rti);
-        auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-        rta->set(index, r);
+        tt.result(r);
 
-        return k;
+        return tt.k();
     }
 };
 
@@ -1312,66 +2403,40 @@ public:
          VMObjectCombinator(VM_OBJECT_FLAG_INTERNAL, m, s) {
     }
 
+    int arity() const override {
+        return 3;
+    }
+
     virtual VMObjectPtr apply(const VMObjectPtr& arg0, const VMObjectPtr& arg1, const VMObjectPtr& arg2) const = 0;
         
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
+        VMFrame tt(thunk);
 
         VMObjectPtr r;
         if (tt.size() > 7) {
-            auto arg0 = tt[5];
-            auto arg1 = tt[6];
-            auto arg2 = tt[7];
+            auto& arg0 = tt[5];
+            auto& arg1 = tt[6];
+            auto& arg2 = tt[7];
 
             try {
+                VMApplyTimer timer;
                 r = apply(arg0, arg1, arg2);
                 if (r == nullptr) {
-                    VMObjectPtrs rr;
-                    for (uint i = 4; i<tt.size(); i++) {
-                        rr.push_back(tt[i]);
-                    }
-                    r = VMObjectArray(rr).clone();
+                    r = tt.slice(4);
                 }
             } catch (VMObjectPtr e) {
-                auto exc   = tt[3];
-                auto ee    = VM_OBJECT_ARRAY_VALUE(exc);
-
-                VMObjectPtrs rr;
-                rr.push_back(ee[0]);
-                rr.push_back(ee[1]);
-                rr.push_back(ee[2]);
-                rr.push_back(ee[3]);
-                rr.push_back(ee[4]);
-                rr.push_back(e);
-
-                return VMObjectArray(rr).clone();
+                return tt.exception(e);
             }
         } else {
-            VMObjectPtrs rr;
-            for (uint i = 4; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
+            r = tt.slice(4);
         }
 
         // also return spurious arguments
-        if (tt.size() > 8) {
-            VMObjectPtrs rr;
-            rr.push_back(r);
-            for (uint i = 8; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
-        }
+        r = tt.applied(r, 8);
 
-        auto index = VM_OBJECT_INTEGER_VALUE(rti);
-        auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-        rta->set(index, r);
+        tt.result(r);
 
-        return k;
+        return tt.k();
     }
 };
 
@@ -1399,54 +2464,32 @@ public:
     virtual VMObjectPtr apply(const VMObjectPtrs& args) const = 0;
         
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
+        VMFrame tt(thunk);
 
         VMObjectPtr r;
         if (tt.size() > 4) {
             VMObjectPtrs args;
+            args.reserve(tt.size() - 5);
             for (uint i = 5; i<tt.size(); i++) {
                 args.push_back(tt[i]);
             }
 
             try {
+                VMApplyTimer timer;
                 r = apply(args);
                 if (r == nullptr) {
-                    VMObjectPtrs rr;
-                    for (uint i = 4; i<tt.size(); i++) {
-                        rr.push_back(tt[i]);
-                    }
-                    r = VMObjectArray(rr).clone();
+                    r = tt.slice(4);
                 }
             } catch (VMObjectPtr e) {
-                auto exc   = tt[3];
-                auto ee    = VM_OBJECT_ARRAY_VALUE(exc);
-
-                VMObjectPtrs rr;
-                rr.push_back(ee[0]);
-                rr.push_back(ee[1]);
-                rr.push_back(ee[2]);
-                rr.push_back(ee[3]);
-                rr.push_back(ee[4]);
-                rr.push_back(e);
-
-                return VMObjectArray(rr).clone();
+                return tt.exception(e);
             }
         } else {
-            VMObjectPtrs rr;
-            for (uint i = 4; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
+            r = tt.slice(4);
         }
 
-        auto index = VM_OBJECT_INTEGER_VALUE(rti);
-        auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-        rta->set(index, r);
+        tt.result(r);
 
-        return k;
+        return tt.k();
     }
 };
 
@@ -1473,68 +2516,37 @@ public:
          VMObjectCombinator(VM_OBJECT_FLAG_INTERNAL, m, s) {
     }
 
+    int arity() const override {
+        return 2;
+    }
+
     virtual VMObjectPtr apply(const VMObjectPtr& arg0, const VMObjectPtr& arg1) const = 0;
         
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
-        auto exc = tt[3];
+        VMFrame tt(thunk);
 
         VMObjectPtr r;
         if (tt.size() > 6) {
-            auto arg0 = tt[5];
-            auto arg1 = tt[6];
+            auto& arg0 = tt[5];
+            auto& arg1 = tt[6];
 
             try {
+                VMApplyTimer timer;
                 r = apply(arg0, arg1);
                 if (r == nullptr) {
-                    VMObjectPtrs rr;
-                    for (uint i = 4; i<tt.size(); i++) {
-                        rr.push_back(tt[i]);
-                    }
-                    r = VMObjectArray(rr).clone();
-
-                    auto index = VM_OBJECT_INTEGER_VALUE(rti);
-                    auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-                    rta->set(index, r);
-
-                    return k;
+                    tt.result(tt.slice(4));
+                    return tt.k();
                 }
             } catch (VMObjectPtr e) {
-                auto exc   = tt[3];
-                auto ee    = VM_OBJECT_ARRAY_VALUE(exc);
-
-                VMObjectPtrs rr;
-                rr.push_back(ee[0]);
-                rr.push_back(ee[1]);
-                rr.push_back(ee[2]);
-                rr.push_back(ee[3]);
-                rr.push_back(ee[4]);
-                rr.push_back(e);
-
-                return VMObjectArray(rr).clone();
+                return tt.exception(e);
             }
         } else {
-            VMObjectPtrs rr;
-            for (uint i = 4; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
-        }
-
-        VMObjectPtrs kk;
-        kk.push_back(rt);
-        kk.push_back(rti);
-        kk.push_back(k);
-        kk.push_back(exc);
-        kk.push_back(r);
-        for (unsigned int n = 7; n < tt.size(); n++) {
-            kk.push_back(tt[n]);
+            // a partial application is a result, not a continuation
+            tt.result(tt.slice(4));
+            return tt.k();
         }
 
-        return VMObjectArray::create(kk);
+        return tt.continuation(r, 7);
     }
 };
 
@@ -1559,69 +2571,38 @@ public:
          VMObjectCombinator(VM_OBJECT_FLAG_INTERNAL, m, s) {
     }
 
+    int arity() const override {
+        return 3;
+    }
+
     virtual VMObjectPtr apply(const VMObjectPtr& arg0, const VMObjectPtr& arg1, const VMObjectPtr& arg2) const = 0;
         
     VMObjectPtr reduce(const VMObjectPtr& thunk) const override {
-        auto tt  = VM_OBJECT_ARRAY_VALUE(thunk);
-        auto rt  = tt[0];
-        auto rti = tt[1];
-        auto k   = tt[2];
-        auto exc = tt[3];
+        VMFrame tt(thunk);
 
         VMObjectPtr r;
         if (tt.size() > 7) {
-            auto arg0 = tt[5];
-            auto arg1 = tt[6];
-            auto arg2 = tt[7];
+            auto& arg0 = tt[5];
+            auto& arg1 = tt[6];
+            auto& arg2 = tt[7];
 
             try {
+                VMApplyTimer timer;
                 r = apply(arg0, arg1, arg2);
                 if (r == nullptr) {
-                    VMObjectPtrs rr;
-                    for (uint i = 4; i<tt.size(); i++) {
-                        rr.push_back(tt[i]);
-                    }
-                    r = VMObjectArray(rr).clone();
-
-                    auto index = VM_OBJECT_INTEGER_VALUE(rti);
-                    auto rta   = VM_OBJECT_ARRAY_CAST(rt);
-                    rta->set(index, r);
-
-                    return k;
+                    tt.result(tt.slice(4));
+                    return tt.k();
                 }
             } catch (VMObjectPtr e) {
-                auto exc   = tt[3];
-                auto ee    = VM_OBJECT_ARRAY_VALUE(exc);
-
-                VMObjectPtrs rr;
-                rr.push_back(ee[0]);
-                rr.push_back(ee[1]);
-                rr.push_back(ee[2]);
-                rr.push_back(ee[3]);
-                rr.push_back(ee[4]);
-                rr.push_back(e);
-
-                return VMObjectArray(rr).clone();
+                return tt.exception(e);
             }
         } else {
-            VMObjectPtrs rr;
-            for (uint i = 4; i<tt.size(); i++) {
-                rr.push_back(tt[i]);
-            }
-            r = VMObjectArray(rr).clone();
-        }
-
-        VMObjectPtrs kk;
-        kk.push_back(rt);
-        kk.push_back(rti);
-        kk.push_back(k);
-        kk.push_back(exc);
-        kk.push_back(r);
-        for (unsigned int n = 8; n < tt.size(); n++) {
-            kk.push_back(tt[n]);
+            // a partial application is a result, not a continuation
+            tt.result(tt.slice(4));
+            return tt.k();
         }
 
-        return VMObjectArray::create(kk);
+        return tt.continuation(r, 8);
     }
 };
 
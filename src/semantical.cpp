@@ -30,10 +30,21 @@ public:
 
     void declare(NamespacePtr& env, const AstPtr& a) {
         _spaces = env;
+        _record = nullptr;
         set_declare_state(STATE_DECLARE_GLOBAL);
         visit(a);
     }
 
+    // list the declarations instead of making them
+    Declarations declarations(const AstPtr& a) {
+        Declarations dd;
+        _spaces = nullptr;
+        _record = &dd;
+        set_declare_state(STATE_DECLARE_GLOBAL);
+        visit(a);
+        return dd;
+    }
+
     // state manipulation
     void set_declare_state(declare_state_t s) {
         _declare_state = s;
@@ -72,7 +83,11 @@ public:
             try {
                 auto nn0 = concat(_qualifications, nn);
                 auto q = qualified(nn0, n);
-                ::declare(_spaces, nn0, n, q);
+                if (_record != nullptr) {
+                    _record->push_back(declaration_t{nn0, n, q, false, p});
+                } else {
+                    ::declare(_spaces, nn0, n, q);
+                }
             } catch (ErrorSemantical &e) {
                 throw ErrorSemantical(p, "redeclaration of " + n);
             }
@@ -82,7 +97,11 @@ public:
                 const UnicodeStrings oo = {"OO"};
                 auto nn0 = concat(oo, nn);
                 auto q = qualified(nn0, n);
-                ::declare_implicit(_spaces, nn0, n, q);
+                if (_record != nullptr) {
+                    _record->push_back(declaration_t{nn0, n, q, true, p});
+                } else {
+                    ::declare_implicit(_spaces, nn0, n, q);
+                }
             } catch (ErrorSemantical &e) {
                 throw ErrorSemantical(p, "redeclaration of " + n);
             }
@@ -127,6 +146,7 @@ public:
 
 private:
     NamespacePtr    _spaces;
+    Declarations*   _record;
     UnicodeStrings  _qualifications;
     declare_state_t _declare_state;
 };
@@ -136,6 +156,42 @@ void declare(NamespacePtr env, const AstPtr& a) {
     declare.declare(env, a);
 }
 
+void declare(NamespacePtr env, const Declarations& dd) {
+    for (auto& d:dd) {
+        if (d.implicit) {
+            ::declare_implicit(env, d.spaces, d.name, d.qualified);
+        } else {
+            try {
+                ::declare(env, d.spaces, d.name, d.qualified);
+            } catch (ErrorSemantical &e) {
+                throw ErrorSemantical(d.position, "redeclaration of " + d.name);
+            }
+        }
+    }
+}
+
+Declarations declarations(const AstPtr& a) {
+    VisitDeclare declare;
+    return declare.declarations(a);
+}
+
+static void namespace_declarations(const NamespacePtr& env, const UnicodeStrings& nn, Declarations& dd) {
+    for (auto& s:env->symbols()) {
+        dd.push_back(declaration_t{nn, s.first, s.second, true, Position()});
+    }
+    for (auto& e:env->embeds()) {
+        UnicodeStrings nn0 = nn;
+        nn0.push_back(e.first);
+        namespace_declarations(e.second, nn0, dd);
+    }
+}
+
+Declarations declarations(const NamespacePtr& env) {
+    Declarations dd;
+    namespace_declarations(env, UnicodeStrings(), dd);
+    return dd;
+}
+
 typedef enum {
     STATE_IDENTIFY_USE,
     STATE_IDENTIFY_PATTERN,
@@ -4,7 +4,22 @@
 #include "ast.hpp"
 #include "environment.hpp"
 
+// a name declared in a namespace, fields of objects are declared implicitly
+typedef struct {
+    UnicodeStrings      spaces;
+    icu::UnicodeString  name;
+    icu::UnicodeString  qualified;
+    bool                implicit;
+    Position            position;
+} declaration_t;
+
+typedef std::vector<declaration_t> Declarations;
+
 void    declare(NamespacePtr env, const AstPtr& a);
+void    declare(NamespacePtr env, const Declarations& dd);
+Declarations declarations(const AstPtr& a);
+// everything declared in a namespace, as implicit declarations
+Declarations declarations(const NamespacePtr& env);
 AstPtr  identify(NamespacePtr env, const AstPtr& a);
 
 #endif
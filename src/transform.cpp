@@ -129,11 +129,11 @@ public:
     }
 
     void visit_expr_let(const Position& p, const AstPtrs& lhs, const AstPtr& rhs, const AstPtr& body) override {
-        visit(rhs); // XXX: shouldn't introduce freevars?
         visit(body);
         set_state(FREEVARS_REMOVE);
         visits(lhs);
         set_state(FREEVARS_INSERT);
+        visit(rhs); // the variables bound don't scope over the right hand side
     }
 
     void visit_decl_object(const Position& p, const AstPtr& c, const AstPtrs& vv, const AstPtrs& ff, const AstPtrs& ee) override {